@@ -5,9 +5,10 @@
 // Unix domain socket interface.
 //
 // Architecture Overview:
-// - Main thread: Handles inotify events and socket accept()
+// - Main thread: epoll reactor driving inotify, socket accept(), timers and shutdown
 // - Worker threads: Process client requests (one thread per connection)
 // - Thread pool: Parallel content search across multiple CPU cores
+// - Persistence writer: Flushes index changes to SQLite (with --db)
 //
 // Security Considerations:
 // - Network input validation with size limits
@@ -17,6 +18,7 @@
 //
 // Key Functions:
 // - index_directory(): Initial filesystem scan
+// - run_event_loop(): epoll reactor (inotify, listening socket, timers, shutdown)
 // - process_events(): Handle inotify events
 // - handle_client(): Process search requests from clients
 // - search_content_worker(): Parallel content search
@@ -28,12 +30,11 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
-#include <queue>
+#include <deque>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
-#include <future>
 #include <chrono>
 #include <filesystem>
 #include <algorithm>
@@ -42,6 +43,9 @@
 #include <stdexcept>
 #include <cerrno>
 #include <cstring>
+#include <climits>
+#include <charconv>
+#include <array>
 #include <cctype>
 #include <iomanip>
 #include <cassert>
@@ -56,12 +60,30 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <arpa/inet.h>
-#include <poll.h>
 #include <sys/uio.h>
 #include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+// io_uring with OPENAT/READ and opcode probing (kernel headers 5.6+);
+// older headers build with synchronous reads only
+#if defined(IORING_FEAT_CUR_PERSONALITY) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING 1
+#endif
 
 // External libraries
 #include <re2/re2.h>
+#include <re2/filtered_re2.h>
+#include <re2/set.h>
 #include <sqlite3.h>
 
 using namespace std;
@@ -145,6 +167,7 @@ void show_version() {
 struct Config {
     bool foreground = false;
     string db_path;
+    bool io_uring = true;     // Prefetch content search reads with io_uring when available
     bool loaded = false;
     string config_file_path;  // Track which file was loaded
 };
@@ -232,6 +255,16 @@ Config parse_config_file(const string& config_path) {
             }
         } else if (key == "db") {
             cfg.db_path = value;
+        } else if (key == "io_uring") {
+            if (value == "true" || value == "yes" || value == "1") {
+                cfg.io_uring = true;
+            } else if (value == "false" || value == "no" || value == "0") {
+                cfg.io_uring = false;
+            } else {
+                cerr << COLOR_YELLOW << "[WARNING]" << COLOR_RESET 
+                     << " Invalid value for 'io_uring' in " << config_path 
+                     << " (expected true/false)\n";
+            }
         } else {
             cerr << COLOR_YELLOW << "[WARNING]" << COLOR_RESET 
                  << " Unknown config key '" << key << "' in " << config_path << "\n";
@@ -273,8 +306,94 @@ Config load_config() {
     return Config();
 }
 
+/**
+ * Class: EntryPath
+ * Purpose: NUL-terminated path of an index entry
+ * 
+ * Normally owns a heap copy of the path. Entries restored from the index
+ * snapshot borrow their path from the mapped string arena instead (see
+ * load_index_snapshot), so startup allocates nothing per path and arena
+ * pages are only read when a path is first used. Copying a borrowed path
+ * copies the pointer; assigning a new path makes the entry own it.
+ * 
+ * The owned buffer does not move with the object, so views of a path stay
+ * valid until it is reassigned or the entry is destroyed.
+ */
+class EntryPath {
+public:
+    EntryPath() = default;
+    EntryPath(string_view s) { assign(s); }
+    EntryPath(const string& s) : EntryPath(string_view(s)) {}
+    EntryPath(const EntryPath& o) : data_(o.data_), size_(o.size_) {
+        if (o.owned_) assign(o.view());
+    }
+    EntryPath(EntryPath&& o) noexcept : data_(o.data_), size_(o.size_), owned_(o.owned_) {
+        o.data_ = "";
+        o.size_ = 0;
+        o.owned_ = false;
+    }
+    ~EntryPath() {
+        if (owned_) delete[] data_;
+    }
+    
+    EntryPath& operator=(EntryPath o) noexcept {
+        swap(data_, o.data_);
+        swap(size_, o.size_);
+        swap(owned_, o.owned_);
+        return *this;
+    }
+    EntryPath& operator=(const string& s) { return *this = EntryPath(s); }
+    EntryPath& operator=(string_view s) { return *this = EntryPath(s); }
+    
+    // Path stored elsewhere (p[len] must be '\0'), kept alive by the caller
+    static EntryPath borrow(const char* p, size_t len) {
+        EntryPath r;
+        r.data_ = p;
+        r.size_ = len;
+        return r;
+    }
+    
+    const char* c_str() const { return data_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    string_view view() const { return string_view(data_, size_); }
+    operator string_view() const { return view(); }
+    string str() const { return string(data_, size_); }
+    
+    bool starts_with(string_view p) const { return view().starts_with(p); }
+    bool ends_with(string_view p) const { return view().ends_with(p); }
+    size_t rfind(char c, size_t pos = string::npos) const { return view().rfind(c, pos); }
+    string substr(size_t pos, size_t n = string::npos) const { return string(view().substr(pos, n)); }
+    
+    friend bool operator==(const EntryPath& a, const EntryPath& b) { return a.view() == b.view(); }
+    friend bool operator==(const EntryPath& a, string_view b) { return a.view() == b; }
+    friend bool operator==(const EntryPath& a, const string& b) { return a.view() == b; }
+    friend ostream& operator<<(ostream& os, const EntryPath& p) { return os << p.view(); }
+    
+private:
+    void assign(string_view s) {
+        char* p = new char[s.size() + 1];
+        memcpy(p, s.data(), s.size());
+        p[s.size()] = '\0';
+        data_ = p;
+        size_ = s.size();
+        owned_ = true;
+    }
+    
+    const char* data_ = "";
+    size_t size_ = 0;
+    bool owned_ = false;
+};
+
+// Hash for string-keyed maps that are searched with a string_view (with equal_to<>)
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(string_view s) const noexcept { return hash<string_view>{}(s); }
+};
+
 struct Entry {
-    string path;
+    EntryPath path;
     int64_t size = 0;
     time_t mtime = 0;
     bool is_dir = false;
@@ -290,72 +409,129 @@ struct PathIndex {
     unordered_set<string> all_dirs;
 };
 
-// Thread pool for parallel content search
-class ThreadPool {
+/**
+ * Class: WorkStealingPool
+ * Purpose: Scheduler for content search with one task deque per worker
+ * 
+ * Tasks are plain PoolTask values (function pointer, context, index), so
+ * submitting a batch allocates nothing per task. submit() deals the tasks
+ * round-robin across the worker deques under one short lock each; a worker
+ * takes from the front of its own deque and, when that is empty, steals
+ * from the back of another worker's. Owners working front-to-back keep
+ * completion roughly in submission order, which lets handle_client()
+ * stream results in order without waiting on the slowest file.
+ * 
+ * Thread-safety: submit() and cancel() may be called from any thread. A
+ * task must not throw; exceptions are swallowed to keep the worker alive.
+ */
+struct PoolTask {
+    void (*run)(void* ctx, uint32_t index) = nullptr;
+    void* ctx = nullptr;
+    uint32_t index = 0;
+};
+
+class WorkStealingPool {
 private:
+    struct WorkerQueue {
+        mutex lock;
+        deque<PoolTask> tasks;
+    };
+    vector<unique_ptr<WorkerQueue>> queues;
     vector<thread> workers;
-    queue<function<void()>> tasks;
-    mutex queue_mutex;
-    condition_variable condition;
-    bool stop;
+    mutex sleep_mutex;
+    condition_variable wake;
+    atomic<size_t> queued{0};     // Tasks sitting in any deque
+    atomic<size_t> next_queue{0}; // Round-robin start for submit()
+    bool stop = false;            // protected by sleep_mutex
+    
+    bool pop_own(size_t self, PoolTask& out) {
+        WorkerQueue& q = *queues[self];
+        lock_guard<mutex> lk(q.lock);
+        if (q.tasks.empty()) return false;
+        out = q.tasks.front();
+        q.tasks.pop_front();
+        return true;
+    }
     
-public:
-    ThreadPool(size_t threads) : stop(false) {
-        for (size_t i = 0; i < threads; ++i) {
-            workers.emplace_back([this] {
-                while (true) {
-                    function<void()> task;
-                    {
-                        unique_lock<mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock, [this] { 
-                            return this->stop || !this->tasks.empty(); 
-                        });
-                        
-                        if (this->stop && this->tasks.empty()) return;
-                        
-                        task = move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-                    try {
-                        task();
-                    } catch (const exception& e) {
-                        // Silently catch exceptions here to prevent worker thread termination.
-                        // Exceptions from the user task are already captured by std::packaged_task
-                        // and will be re-thrown when future.get() is called.
-                    } catch (...) {
-                        // Catch any other exceptions to keep the worker thread alive.
-                    }
+    bool steal(size_t self, PoolTask& out) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            WorkerQueue& q = *queues[(self + i) % queues.size()];
+            lock_guard<mutex> lk(q.lock);
+            if (q.tasks.empty()) continue;
+            out = q.tasks.back();
+            q.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+    
+    void worker_loop(size_t self) {
+        while (true) {
+            PoolTask task;
+            if (pop_own(self, task) || steal(self, task)) {
+                queued--;
+                try {
+                    task.run(task.ctx, task.index);
+                } catch (...) {
+                    // Keep the worker alive; the task reports its own failure
                 }
-            });
+                continue;
+            }
+            unique_lock<mutex> lk(sleep_mutex);
+            wake.wait(lk, [this] { return stop || queued.load() > 0; });
+            if (stop && queued.load() == 0) return;
         }
     }
     
-    template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args) 
-        -> future<invoke_result_t<F, Args...>> {
-        
-        using return_type = invoke_result_t<F, Args...>;
-        
-        auto task = make_shared<packaged_task<return_type()>>(
-            bind(forward<F>(f), forward<Args>(args)...)
-        );
-        
-        future<return_type> res = task->get_future();
+public:
+    explicit WorkStealingPool(size_t threads) {
+        for (size_t i = 0; i < threads; ++i) queues.push_back(make_unique<WorkerQueue>());
+        for (size_t i = 0; i < threads; ++i) workers.emplace_back([this, i] { worker_loop(i); });
+    }
+    
+    size_t size() const { return workers.size(); }
+    
+    void submit(const PoolTask* tasks, size_t count) {
+        if (count == 0) return;
+        // Count the tasks before they become visible: a worker's decrement
+        // or a cancel() must never run ahead of this and wrap the counter
+        queued += count;
+        size_t start = next_queue.fetch_add(1) % queues.size();
+        for (size_t w = 0; w < queues.size() && w < count; w++) {
+            WorkerQueue& q = *queues[(start + w) % queues.size()];
+            lock_guard<mutex> lk(q.lock);
+            for (size_t i = w; i < count; i += queues.size()) q.tasks.push_back(tasks[i]);
+        }
         {
-            unique_lock<mutex> lock(queue_mutex);
-            if (stop) throw runtime_error("enqueue on stopped ThreadPool");
-            tasks.emplace([task]() { (*task)(); });
+            // Pairs with the predicate check in worker_loop(): no lost wakeups
+            lock_guard<mutex> lk(sleep_mutex);
+        }
+        if (count == 1) wake.notify_one(); else wake.notify_all();
+    }
+    
+    // Drop the tasks of one context that no worker has started yet and
+    // append their indices to removed; running tasks are not affected
+    size_t cancel(void* ctx, vector<uint32_t>& removed) {
+        size_t before = removed.size();
+        for (auto& q : queues) {
+            lock_guard<mutex> lk(q->lock);
+            auto kept = remove_if(q->tasks.begin(), q->tasks.end(), [&](const PoolTask& t) {
+                if (t.ctx != ctx) return false;
+                removed.push_back(t.index);
+                return true;
+            });
+            q->tasks.erase(kept, q->tasks.end());
         }
-        condition.notify_one();
-        return res;
+        queued -= removed.size() - before;
+        return removed.size() - before;
     }
     
-    ~ThreadPool() {
+    ~WorkStealingPool() {
         {
-            unique_lock<mutex> lock(queue_mutex);
+            lock_guard<mutex> lk(sleep_mutex);
             stop = true;
         }
-        condition.notify_all();
+        wake.notify_all();
         for (thread& worker : workers) {
             worker.join();
         }
@@ -374,12 +550,39 @@ volatile sig_atomic_t running = 1;
 atomic<int> srv_fd{-1};  // Atomic socket fd for signal-safe access
 atomic<bool> shutdown_started{false};  // Global to avoid static initialization guard in signal handler
 int in_fd = -1;
-unordered_map<int, string> wd_to_dir;
+
+// Watched directory node: resolved once when the watch is added so event
+// handling never has to scan root_paths or copy the directory string.
+// Nodes form a tree mirroring the directory hierarchy, so renaming or
+// removing a subtree only visits the watches underneath it.
+constexpr uint32_t NO_NODE = UINT32_MAX;
+struct DirNode {
+    string path;                // Full directory path as passed to inotify_add_watch
+    size_t root_index = 0;      // Which root this directory belongs to
+    int wd = -1;                // Watch descriptor (-1 when the slot is free)
+    uint32_t parent = NO_NODE;  // Parent directory node (NO_NODE for roots)
+    unordered_map<string, uint32_t> children;  // Basename -> child node id
+};
+vector<DirNode> dir_nodes;             // Indexed by node id
+vector<uint32_t> free_dir_nodes;       // Recycled node ids
+unordered_map<int, uint32_t> wd_to_node;
+
+// Event loop file descriptors (see run_event_loop)
+int epoll_fd = -1;
+int shutdown_efd = -1;   // eventfd written by sig_handler to wake the reactor
+int cleanup_tfd = -1;    // timerfd for stale pending move cleanup (armed on demand)
+int flush_tfd = -1;      // timerfd for periodic database flushes
 
 // Directory rename tracking
-unordered_map<uint32_t, pair<string, chrono::steady_clock::time_point>> pending_moves;
+struct PendingMove {
+    string path;                          // Directory path at IN_MOVED_FROM time
+    chrono::steady_clock::time_point time;
+    uint32_t node = NO_NODE;              // Watch node of the moved directory, if any
+};
+unordered_map<uint32_t, PendingMove> pending_moves;
 mutex pending_moves_mtx;
 bool foreground = false;
+bool use_io_uring = true;  // Config "io_uring": content search may prefetch with io_uring
 
 // SQLite persistence
 sqlite3* db = nullptr;
@@ -387,20 +590,288 @@ string db_path;
 bool db_enabled = false;
 atomic<int> pending_changes{0};
 atomic<bool> db_dirty{false};
-chrono::steady_clock::time_point last_flush_time;
+atomic<chrono::steady_clock::time_point> last_flush_time;
 const int FLUSH_INTERVAL_SEC = 30;
 const int FLUSH_THRESHOLD = 100;
 mutex db_mtx;
 
+// Background persistence writer (see db_writer_loop). The event loop only
+// requests flushes; all SQLite work during normal operation happens here.
+thread db_writer;
+mutex db_writer_mtx;
+condition_variable db_writer_cv;
+bool db_flush_requested = false;  // protected by db_writer_mtx
+bool db_writer_stop = false;      // protected by db_writer_mtx
+
+// Binary index snapshot (see write_index_snapshot). db_generation is bumped in
+// the same transaction as every flush, so a snapshot is only trusted when it
+// was written at the generation the database is currently at.
+atomic<uint64_t> db_generation{0};
+atomic<int64_t> snapshot_generation{-1};  // Generation of the snapshot on disk, -1 if none/unknown
+const int SNAPSHOT_INTERVAL_SEC = 300;    // Minimum time between snapshots written after flushes
+chrono::steady_clock::time_point last_snapshot_time;  // db_writer thread only
+bool path_index_valid = false;     // path_index matches entries (snapshot load/reconcile; protected by mtx)
+
+// Streaming database load (see load_entries_from_db). While db_loader runs,
+// entries grows batch by batch and queries see what has arrived so far.
+const size_t LOAD_BATCH_ENTRIES = 8192;  // Rows published into entries per mtx acquisition
+const unsigned MAX_LOAD_CONNECTIONS = 8;
+atomic<bool> index_complete{true};  // false until the background load, replay and reconcile finish
+thread db_loader;
+int loader_efd = -1;                // eventfd written by db_loader when it is done
+
+// Metadata query cache (see handle_client). index_generation is bumped on
+// every change to entries; single-path changes are also journaled, so a
+// cached result can be brought up to date by re-checking only the paths
+// changed since it was computed. Bulk changes (load, reconcile, directory
+// rename) reset the journal, forcing a full scan. All protected by mtx.
+struct IndexChange {
+    uint64_t generation;
+    string path;
+    bool subtree;  // Everything under path was removed
+};
+const size_t INDEX_JOURNAL_MAX = 1024;
+uint64_t index_generation = 0;
+uint64_t index_journal_floor = 0;  // The journal holds every change after this generation
+deque<IndexChange> index_journal;
+
+struct MetadataQueryResult {
+    string key;
+    uint64_t generation = 0;
+    uint64_t last_used = 0;
+    size_t bytes = 0;
+    vector<string> results;
+};
+const size_t METADATA_CACHE_QUERIES = 32;
+const size_t METADATA_CACHE_BYTES = 32 * 1024 * 1024;
+vector<MetadataQueryResult> metadata_cache;
+uint64_t metadata_cache_clock = 0;
+size_t metadata_cache_bytes = 0;
+
+// Record a change to one path (caller holds mtx)
+void note_index_change(const string& path, bool subtree = false) {
+    index_generation++;
+    index_journal.push_back(IndexChange{index_generation, path, subtree});
+    if (index_journal.size() > INDEX_JOURNAL_MAX) {
+        index_journal_floor = index_journal.front().generation;
+        index_journal.pop_front();
+    }
+}
+
+// Record a change that cannot be described path by path (caller holds mtx)
+void note_index_reset() {
+    index_generation++;
+    index_journal.clear();
+    index_journal_floor = index_generation;
+}
+
+// Dirty set: the latest unflushed change for each path (protected by mtx).
+// Flushes persist only these rows, so their cost scales with the number of
+// changes rather than the size of the index.
+struct DirtyRecord {
+    bool deleted = false;
+    int64_t size = 0;
+    time_t mtime = 0;
+    bool is_dir = false;
+    size_t root_index = 0;
+};
+unordered_map<string, DirtyRecord> dirty_entries;
+bool db_full_rewrite = false;  // Fresh index: replace the whole table on next flush (protected by mtx)
+
+// Change journal (see replay_journal). Every dirty set mutation is also
+// appended to "<db>.journal" and made durable by the journal_writer thread
+// with group commit, so a crash loses at most the records of the last
+// fdatasync() instead of everything since the previous flush.
+constexpr char JOURNAL_MAGIC[8] = {'F', 'F', 'I', 'N', 'D', 'J', 'N', 'L'};
+constexpr uint32_t JOURNAL_VERSION = 1;
+constexpr size_t JOURNAL_HEADER_SIZE = 16;         // magic + version + reserved
+constexpr off_t JOURNAL_COMPACT_BYTES = 4 << 20;   // Rewrite a partly checkpointed journal above this size
+
+struct JournalRecord {      // Followed by path_len bytes of path
+    uint32_t checksum;      // Over the rest of the record, including the path
+    uint32_t path_len;
+    uint64_t seq;
+    int64_t size;
+    int64_t mtime;
+    uint32_t root_index;
+    uint8_t deleted;
+    uint8_t is_dir;
+    uint16_t reserved;
+};
+static_assert(sizeof(JournalRecord) == 40, "journal record layout is part of the file format");
+
+bool journal_enabled = false;
+int journal_fd = -1;
+thread journal_writer;
+mutex journal_mtx;
+condition_variable journal_cv;
+string journal_buf;                       // Encoded records not yet written (protected by journal_mtx)
+uint64_t journal_seq = 0;                 // Last sequence number assigned (protected by journal_mtx)
+uint64_t journal_checkpoint = 0;          // Highest seq persisted in SQLite (protected by journal_mtx)
+bool journal_checkpoint_pending = false;  // protected by journal_mtx
+bool journal_stop = false;                // protected by journal_mtx
+uint64_t db_journal_seq = 0;              // meta.journal_seq: records up to here are in the database
+
+static uint32_t journal_checksum(const char* data, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// Queue one mutation for the journal writer (caller holds mtx, so records
+// are numbered in the same order as the dirty set sees them)
+void journal_append(string_view path, const DirtyRecord& rec) {
+    if (!journal_enabled) return;
+    
+    JournalRecord r {};
+    r.path_len = static_cast<uint32_t>(path.size());
+    r.size = rec.size;
+    r.mtime = rec.mtime;
+    r.root_index = static_cast<uint32_t>(rec.root_index);
+    r.deleted = rec.deleted ? 1 : 0;
+    r.is_dir = rec.is_dir ? 1 : 0;
+    {
+        lock_guard<mutex> lk(journal_mtx);
+        r.seq = ++journal_seq;
+        size_t off = journal_buf.size();
+        journal_buf.append(reinterpret_cast<const char*>(&r), sizeof(r));
+        journal_buf.append(path);
+        uint32_t sum = journal_checksum(journal_buf.data() + off + sizeof(uint32_t),
+                                        sizeof(r) - sizeof(uint32_t) + path.size());
+        memcpy(&journal_buf[off], &sum, sizeof(sum));
+    }
+    journal_cv.notify_one();
+}
+
+// Records up to seq are now in SQLite; let the journal writer drop them
+void journal_checkpoint_at(uint64_t seq) {
+    if (!journal_enabled) return;
+    {
+        lock_guard<mutex> lk(journal_mtx);
+        journal_checkpoint = max(journal_checkpoint, seq);
+        journal_checkpoint_pending = true;
+    }
+    journal_cv.notify_one();
+}
+
+// Record an inserted/updated entry for the next flush (caller holds mtx)
+void mark_dirty_upsert(const Entry& e) {
+    if (!db_enabled || db_full_rewrite) return;
+    DirtyRecord rec {false, e.size, e.mtime, e.is_dir, e.root_index};
+    dirty_entries[e.path.str()] = rec;
+    journal_append(e.path, rec);
+}
+
+// Record a deleted path for the next flush (caller holds mtx)
+void mark_dirty_delete(string_view path) {
+    if (!db_enabled || db_full_rewrite) return;
+    DirtyRecord rec {true};
+    dirty_entries[string(path)] = rec;
+    journal_append(path, rec);
+}
+
+/*
+ * Content result cache
+ * 
+ * Editors and CI repeat identical content searches. Each distinct query
+ * (pattern, flags, context) gets a slot mapping file path -> results of the
+ * last scan, stamped with the file's identity (size, mtime in ns, inode). A
+ * candidate whose stat() still matches the stamp is answered from the slot
+ * without being opened; empty results are cached too, so unchanged files
+ * without matches cost one stat(). inotify updates and removals erase the
+ * path from every slot, and the identity check covers changes inotify has
+ * not reported yet.
+ * 
+ * Bounds: CONTENT_CACHE_QUERIES slots (least recently used is dropped) and
+ * CONTENT_CACHE_BYTES in total; once full, new results are not cached.
+ */
+const size_t CONTENT_CACHE_QUERIES = 16;
+const size_t CONTENT_CACHE_BYTES = 64 * 1024 * 1024;
+const size_t CONTENT_CACHE_ENTRY_OVERHEAD = 96;  // Approximate per-file map cost
+
+struct CachedFileResult {
+    int64_t size = 0;
+    int64_t mtime_ns = 0;
+    ino_t ino = 0;
+    string results;
+    vector<uint32_t> marks;  // Start of each match's output within results
+};
+
+struct ContentCacheSlot {
+    string key;
+    mutex lock;  // Guards files and bytes
+    unordered_map<string, CachedFileResult, StringHash, equal_to<>> files;
+    size_t bytes = 0;
+    uint64_t last_used = 0;
+};
+
+mutex content_cache_mtx;  // Guards the slot list and the use counter
+vector<shared_ptr<ContentCacheSlot>> content_cache;
+uint64_t content_cache_clock = 0;
+atomic<size_t> content_cache_bytes{0};
+
+// Slot for a query key, created (evicting the least recently used) if needed
+shared_ptr<ContentCacheSlot> content_cache_slot(const string& key) {
+    lock_guard<mutex> lk(content_cache_mtx);
+    for (auto& slot : content_cache) {
+        if (slot->key == key) {
+            slot->last_used = ++content_cache_clock;
+            return slot;
+        }
+    }
+    if (content_cache.size() >= CONTENT_CACHE_QUERIES) {
+        auto lru = min_element(content_cache.begin(), content_cache.end(),
+                               [](const auto& a, const auto& b) { return a->last_used < b->last_used; });
+        {
+            lock_guard<mutex> slot_lk((*lru)->lock);
+            content_cache_bytes -= (*lru)->bytes;
+            (*lru)->bytes = 0;
+        }
+        content_cache.erase(lru);  // Searches still holding the slot keep it alive
+    }
+    auto slot = make_shared<ContentCacheSlot>();
+    slot->key = key;
+    slot->last_used = ++content_cache_clock;
+    content_cache.push_back(slot);
+    return slot;
+}
+
+// Forget cached results for a path (or everything under it when recursive)
+void content_cache_invalidate(const string& path, bool recursive = false) {
+    lock_guard<mutex> lk(content_cache_mtx);
+    for (auto& slot : content_cache) {
+        lock_guard<mutex> slot_lk(slot->lock);
+        auto drop = [&](decltype(slot->files)::iterator it) {
+            size_t cost = it->first.size() + it->second.results.size() + it->second.marks.size() * sizeof(uint32_t) +
+                          CONTENT_CACHE_ENTRY_OVERHEAD;
+            slot->bytes -= cost;
+            content_cache_bytes -= cost;
+            return slot->files.erase(it);
+        };
+        if (!recursive) {
+            auto it = slot->files.find(path);
+            if (it != slot->files.end()) drop(it);
+            continue;
+        }
+        string prefix = path + "/";
+        for (auto it = slot->files.begin(); it != slot->files.end();) {
+            it = (it->first == path || it->first.starts_with(prefix)) ? drop(it) : next(it);
+        }
+    }
+}
+
 // Thread pool for parallel content search
-unique_ptr<ThreadPool> content_search_pool;
+unique_ptr<WorkStealingPool> content_search_pool;
 
 // Initialize thread pool for content search
 void init_thread_pool() {
     size_t num_threads = thread::hardware_concurrency();
     if (num_threads == 0) num_threads = 4;  // Default fallback
     
-    content_search_pool = make_unique<ThreadPool>(num_threads);
+    content_search_pool = make_unique<WorkStealingPool>(num_threads);
     
     if (foreground) {
         cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
@@ -459,9 +930,15 @@ bool check_dnotify_available() {
  * 
  * Schema Overview:
  * - meta: Key-value pairs for root paths and configuration
- * - entries: File/directory index (path, size, mtime, is_dir, root_index)
+ * - dirs: One row per parent directory path (id, path)
+ * - dir_entries: File/directory index keyed by (dir_id, name), WITHOUT ROWID
+ * - entries: View joining the two back into (path, size, mtime, is_dir, root_index)
  * - sync_state: Tracks last full sync time and dirty flag
  * 
+ * Storing each directory path once and only basenames per row keeps the
+ * table and its primary-key B-tree a fraction of the size of one absolute
+ * path per row. Databases from before this layout are converted on open.
+ * 
  * WAL Mode Benefits:
  * - Atomic commits even on crashes or power loss
  * - Better read concurrency (readers don't block writers)
@@ -501,6 +978,30 @@ bool init_database(const string& path) {
         sqlite3_free(err_msg);
     }
     
+    // Older databases have a plain "entries" table with one absolute path per
+    // row; rename it so its rows can be moved into the new layout below
+    bool legacy_entries = false;
+    sqlite3_stmt* legacy_stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'entries'",
+                           -1, &legacy_stmt, nullptr) == SQLITE_OK) {
+        legacy_entries = sqlite3_step(legacy_stmt) == SQLITE_ROW;
+        sqlite3_finalize(legacy_stmt);
+    }
+    if (legacy_entries) {
+        rc = sqlite3_exec(db, "BEGIN IMMEDIATE; ALTER TABLE entries RENAME TO entries_v1;",
+                          nullptr, nullptr, &err_msg);
+        if (rc != SQLITE_OK) {
+            if (foreground) {
+                cerr << COLOR_RED << "ERROR: Cannot upgrade database: " << err_msg << COLOR_RESET << "\n";
+            }
+            sqlite3_free(err_msg);
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            sqlite3_close(db);
+            db = nullptr;
+            return false;
+        }
+    }
+    
     // Create schema
     const char* schema = R"(
         CREATE TABLE IF NOT EXISTS meta (
@@ -508,16 +1009,24 @@ bool init_database(const string& path) {
             value TEXT
         );
         
-        CREATE TABLE IF NOT EXISTS entries (
+        CREATE TABLE IF NOT EXISTS dirs (
             id INTEGER PRIMARY KEY,
-            path TEXT UNIQUE NOT NULL,
+            path TEXT UNIQUE NOT NULL
+        );
+        
+        CREATE TABLE IF NOT EXISTS dir_entries (
+            dir_id INTEGER NOT NULL,
+            name TEXT NOT NULL,
             size INTEGER NOT NULL,
             mtime INTEGER NOT NULL,
             is_dir INTEGER NOT NULL,
-            root_index INTEGER NOT NULL
-        );
+            root_index INTEGER NOT NULL,
+            PRIMARY KEY (dir_id, name)
+        ) WITHOUT ROWID;
         
-        CREATE INDEX IF NOT EXISTS idx_path ON entries(path);
+        CREATE VIEW IF NOT EXISTS entries AS
+            SELECT d.path || '/' || e.name AS path, e.size, e.mtime, e.is_dir, e.root_index
+            FROM dir_entries e JOIN dirs d ON d.id = e.dir_id;
         
         CREATE TABLE IF NOT EXISTS sync_state (
             id INTEGER PRIMARY KEY CHECK (id = 1),
@@ -529,16 +1038,53 @@ bool init_database(const string& path) {
     )";
     
     rc = sqlite3_exec(db, schema, nullptr, nullptr, &err_msg);
+    if (rc == SQLITE_OK && legacy_entries) {
+        // Split each old path at its last '/': rtrim() with the path's own
+        // non-slash characters strips the basename and leaves "dir/"
+        const char* migrate = R"(
+            CREATE TEMP TABLE split AS
+                SELECT path, rtrim(path, replace(path, '/', '')) AS prefix,
+                       size, mtime, is_dir, root_index
+                FROM entries_v1 WHERE instr(path, '/') > 0;
+            INSERT OR IGNORE INTO dirs (path)
+                SELECT DISTINCT substr(prefix, 1, length(prefix) - 1) FROM split;
+            INSERT OR REPLACE INTO dir_entries (dir_id, name, size, mtime, is_dir, root_index)
+                SELECT d.id, substr(s.path, length(s.prefix) + 1), s.size, s.mtime, s.is_dir, s.root_index
+                FROM split s JOIN dirs d ON d.path = substr(s.prefix, 1, length(s.prefix) - 1);
+            DROP TABLE split;
+            DROP TABLE entries_v1;
+        )";
+        rc = sqlite3_exec(db, migrate, nullptr, nullptr, &err_msg);
+        if (rc == SQLITE_OK) rc = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &err_msg);
+        if (rc == SQLITE_OK && foreground) {
+            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Converted database to directory/basename layout\n";
+        }
+    }
     if (rc != SQLITE_OK) {
         if (foreground) {
             cerr << COLOR_RED << "ERROR: Cannot create schema: " << err_msg << COLOR_RESET << "\n";
         }
         sqlite3_free(err_msg);
+        if (legacy_entries) sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
         sqlite3_close(db);
         db = nullptr;
         return false;
     }
     
+    // Current flush generation (validates the index snapshot) and the last
+    // journal record contained in the database
+    sqlite3_stmt* gen_stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT key, value FROM meta WHERE key IN ('generation', 'journal_seq')",
+                           -1, &gen_stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(gen_stmt) == SQLITE_ROW) {
+            string key = reinterpret_cast<const char*>(sqlite3_column_text(gen_stmt, 0));
+            uint64_t value = static_cast<uint64_t>(sqlite3_column_int64(gen_stmt, 1));
+            if (key == "generation") db_generation = value;
+            else db_journal_seq = value;
+        }
+        sqlite3_finalize(gen_stmt);
+    }
+    
     return true;
 }
 
@@ -716,121 +1262,492 @@ void save_roots_to_db(const vector<string>& roots) {
     }
 }
 
-void load_entries_from_db() {
-    if (!db) return;
-    
-    lock_guard<mutex> lk(mtx);
-    entries.clear();
-    
+/**
+ * Function: load_dir_range
+ * Purpose: Load the rows of directories with ids in [lo, hi] into entries
+ * Parameters:
+ *   - lo, hi: Inclusive dirs.id range (dir_entries key prefix)
+ * Returns: Number of entries loaded
+ * Thread-safety: Thread-safe; uses its own read-only connection and
+ *                publishes into entries under mtx every LOAD_BATCH_ENTRIES rows
+ */
+static size_t load_dir_range(sqlite3_int64 lo, sqlite3_int64 hi) {
+    sqlite3* conn = nullptr;
+    if (sqlite3_open_v2(db_path.c_str(), &conn, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                        nullptr) != SQLITE_OK) {
+        sqlite3_close(conn);
+        conn = db;  // Shared handle is serialized, just slower under contention
+    }
+
+    // Directory paths first; each row then only carries its basename
+    unordered_map<sqlite3_int64, string> dir_paths;
     sqlite3_stmt* stmt;
-    const char* sql = "SELECT path, size, mtime, is_dir, root_index FROM entries";
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+    if (sqlite3_prepare_v2(conn, "SELECT id, path FROM dirs WHERE id BETWEEN ?1 AND ?2",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, lo);
+        sqlite3_bind_int64(stmt, 2, hi);
         while (sqlite3_step(stmt) == SQLITE_ROW) {
+            dir_paths.emplace(sqlite3_column_int64(stmt, 0),
+                              reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    size_t loaded = 0;
+    vector<Entry> batch;
+    batch.reserve(LOAD_BATCH_ENTRIES);
+    auto publish = [&]() {
+        lock_guard<mutex> lk(mtx);
+        entries.insert(entries.end(), make_move_iterator(batch.begin()), make_move_iterator(batch.end()));
+        loaded += batch.size();
+        batch.clear();
+    };
+
+    const char* sql = "SELECT dir_id, name, size, mtime, is_dir, root_index FROM dir_entries "
+                      "WHERE dir_id BETWEEN ?1 AND ?2";
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, lo);
+        sqlite3_bind_int64(stmt, 2, hi);
+        const string* dir = nullptr;
+        sqlite3_int64 last_dir_id = 0;
+        string path;
+        while (running && sqlite3_step(stmt) == SQLITE_ROW) {
+            // Rows come out in (dir_id, name) order, so the lookup changes rarely
+            sqlite3_int64 dir_id = sqlite3_column_int64(stmt, 0);
+            if (!dir || dir_id != last_dir_id) {
+                auto it = dir_paths.find(dir_id);
+                dir = it == dir_paths.end() ? nullptr : &it->second;
+                last_dir_id = dir_id;
+            }
+            if (!dir) continue;  // Orphaned row
+            
+            const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            int name_len = sqlite3_column_bytes(stmt, 1);
             Entry e;
-            e.path = (const char*)sqlite3_column_text(stmt, 0);
-            e.size = sqlite3_column_int64(stmt, 1);
-            e.mtime = sqlite3_column_int64(stmt, 2);
-            e.is_dir = sqlite3_column_int(stmt, 3) != 0;
-            e.root_index = sqlite3_column_int(stmt, 4);
-            entries.push_back(e);
+            path.assign(*dir).append(1, '/').append(name, name_len);
+            e.path = path;
+            e.size = sqlite3_column_int64(stmt, 2);
+            e.mtime = sqlite3_column_int64(stmt, 3);
+            e.is_dir = sqlite3_column_int(stmt, 4) != 0;
+            e.root_index = sqlite3_column_int(stmt, 5);
+            batch.push_back(move(e));
+            if (batch.size() >= LOAD_BATCH_ENTRIES) publish();
+        }
+        sqlite3_finalize(stmt);
+    }
+    publish();
+
+    if (conn != db) sqlite3_close(conn);
+    return loaded;
+}
+
+/**
+ * Function: load_entries_from_db
+ * Purpose: Load all persisted entries, reading dirs.id ranges in parallel
+ * Parameters: None
+ * Returns: void
+ * Thread-safety: Takes mtx only to publish batches, so queries can run
+ *                against the rows loaded so far (see start_db_loader)
+ *
+ * dir_entries is a WITHOUT ROWID table keyed by (dir_id, name), so the id
+ * space of dirs is split into contiguous ranges, one per connection; each
+ * range is a key-prefix range scan of both tables.
+ */
+void load_entries_from_db() {
+    if (!db) return;
+
+    {
+        lock_guard<mutex> lk(mtx);
+        entries.clear();
+        path_index.dir_to_entries.clear();
+        path_index.all_dirs.clear();
+        path_index_valid = false;
+        note_index_reset();
+    }
+
+    sqlite3_int64 min_id = 0, max_id = -1;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT min(id), max(id) FROM dirs", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+            min_id = sqlite3_column_int64(stmt, 0);
+            max_id = sqlite3_column_int64(stmt, 1);
         }
         sqlite3_finalize(stmt);
     }
+    if (max_id < min_id) return;
+
+    auto start_time = chrono::steady_clock::now();
+    unsigned workers = clamp(thread::hardware_concurrency(), 1u, MAX_LOAD_CONNECTIONS);
+    sqlite3_int64 span = max_id - min_id + 1;
+    if (span < static_cast<sqlite3_int64>(workers)) workers = static_cast<unsigned>(span);
+    sqlite3_int64 step = (span + workers - 1) / workers;
+
+    atomic<size_t> loaded{0};
+    vector<thread> threads;
+    for (unsigned w = 0; w < workers; w++) {
+        sqlite3_int64 lo = min_id + step * w;
+        sqlite3_int64 hi = min(max_id, lo + step - 1);
+        threads.emplace_back([lo, hi, &loaded]() { loaded += load_dir_range(lo, hi); });
+    }
+    for (auto& t : threads) t.join();
+
+    if (foreground) {
+        auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_time).count();
+        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Loaded " << loaded.load()
+             << " entries from database (" << workers << " connections, " << ms << " ms)\n";
+    }
+}
+
+// Last path component of an entry or directory node path
+static string_view dir_base_name(string_view path) {
+    size_t pos = path.rfind('/');
+    return pos == string::npos ? string_view(path) : string_view(path).substr(pos + 1);
+}
+
+void build_path_index() {
+    // This function must be called in a single-threaded context (e.g., during daemon startup)
+    // or with mtx already held by the caller. It does NOT acquire the mutex itself.
+    // DO NOT call this from multiple threads without external synchronization.
+    
+    // Clear existing index
+    path_index.dir_to_entries.clear();
+    path_index.all_dirs.clear();
+    note_index_reset();
+    
+    for (auto& e : entries) {
+        // Extract directory path from entry path
+        size_t last_slash = e.path.rfind('/');
+        if (last_slash == string::npos) continue;  // Skip entries without directory
+        
+        string dir = e.path.substr(0, last_slash);
+        
+        // Add entry to directory index
+        path_index.dir_to_entries[dir].push_back(&e);
+        
+        // Track unique directories
+        path_index.all_dirs.insert(dir);
+    }
     
     if (foreground) {
-        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Loaded " << entries.size() 
-             << " entries from database\n";
+        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
+             << " Path index built: " << path_index.all_dirs.size() 
+             << " directories indexed\n";
     }
 }
 
+/**
+ * Function: reconcile_db_with_filesystem
+ * Purpose: Bring entries loaded from the database/snapshot up to date with
+ *          changes made while the daemon was not running
+ * Parameters: None
+ * Returns: void
+ * Thread-safety: Startup only, before inotify events are processed (from
+ *                main() or the db_loader thread). Only the caller writes
+ *                entries and path_index meanwhile, so the walk reads them
+ *                without mtx; building the path index and the final update
+ *                take it, since queries may be running
+ * 
+ * Adding, removing or renaming a directory entry updates the directory's
+ * mtime, so only directories whose mtime differs from the stored one are
+ * listed and have their children lstat'ed. Unchanged directories cost one
+ * lstat of each subdirectory to decide whether to descend. Directories are
+ * processed by a pool of threads sharing a work queue.
+ * 
+ * A stored mtime at or after the last flush (sync_state.last_full_sync) is
+ * "racy": a change in that same second would leave the mtime unchanged, so
+ * such directories are always listed.
+ * 
+ * The walk stops early once 'running' is cleared, leaving entries as they
+ * were; the caller then treats the index as incomplete.
+ * 
+ * REVIEWER_NOTE: A file whose contents changed offline, without any entry
+ * being added or removed in its directory, keeps its stored size/mtime
+ * until inotify next reports it. This is the price of not stat'ing every file.
+ */
 void reconcile_db_with_filesystem() {
     if (!db) return;
     
-    // Build map of current entries from DB
-    unordered_map<string, Entry> db_entries;
     {
         lock_guard<mutex> lk(mtx);
-        for (const auto& e : entries) {
-            db_entries[e.path] = e;
+        if (!path_index_valid) {
+            build_path_index();
+            path_index_valid = true;
         }
     }
     
-    // Track statistics and changes
-    int added = 0, removed = 0, updated = 0;
-    vector<Entry> new_entries;
-    unordered_set<string> found_paths;
-    
-    // Walk filesystem and build new entry list
-    for (size_t root_idx = 0; root_idx < root_paths.size(); root_idx++) {
-        try {
-            for (auto& e : recursive_directory_iterator(root_paths[root_idx], 
-                                                       directory_options::skip_permission_denied)) {
-                string p = e.path().string();
-                found_paths.insert(p);
-                
-                struct stat st {};
-                if (lstat(p.c_str(), &st) != 0) continue;
-                
-                bool is_dir = S_ISDIR(st.st_mode);
-                int64_t sz = is_dir ? 0LL : st.st_size;
-                time_t mtime = st.st_mtime;
-                
-                auto it = db_entries.find(p);
-                if (it == db_entries.end()) {
-                    // File not in DB - add it
-                    Entry entry;
-                    entry.path = p;
-                    entry.size = sz;
-                    entry.mtime = mtime;
-                    entry.is_dir = is_dir;
-                    entry.root_index = root_idx;
-                    new_entries.push_back(entry);
-                    added++;
-                } else {
-                    // File exists - check if modified
-                    if (it->second.size != sz || it->second.mtime != mtime) {
-                        Entry entry = it->second;
-                        entry.size = sz;
-                        entry.mtime = mtime;
-                        entry.is_dir = is_dir;
-                        new_entries.push_back(entry);
-                        updated++;
-                    } else {
-                        // No change
-                        new_entries.push_back(it->second);
-                    }
-                }
-            }
-        } catch (...) {}
+    // Changes made after the last flush may share a second with stored mtimes
+    time_t last_sync = 0;
+    sqlite3_stmt* sync_stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT last_full_sync FROM sync_state WHERE id = 1", -1, &sync_stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(sync_stmt) == SQLITE_ROW) last_sync = sqlite3_column_int64(sync_stmt, 0);
+        sqlite3_finalize(sync_stmt);
     }
-    
-    // Count entries that were removed (in DB but not on filesystem)
-    for (const auto& [path, entry] : db_entries) {
-        if (found_paths.find(path) == found_paths.end()) {
-            removed++;
+    auto racy = [last_sync](const Entry* e) { return e->mtime >= last_sync; };
+    
+    // Entries outside every current root are dropped; entries whose root moved
+    // to a different index (root list reordered) are re-tagged. Roots always
+    // end in '/'.
+    vector<char> removed_flag(entries.size(), 0);
+    vector<pair<Entry*, Entry>> updates;
+    int removed = 0;
+    for (auto& e : entries) {
+        size_t owner = root_paths.size();
+        for (size_t r = 0; r < root_paths.size(); r++) {
+            const string& root = root_paths[r];
+            if (e.path.size() > root.size() && e.path.starts_with(root)) {
+                owner = r;
+                break;
+            }
+        }
+        if (owner == root_paths.size()) {
+            removed_flag[&e - entries.data()] = 1;
+        } else if (owner != e.root_index) {
+            Entry moved = e;
+            moved.root_index = owner;
+            updates.emplace_back(&e, moved);
         }
     }
     
-    // Replace entries with reconciled list
-    {
-        lock_guard<mutex> lk(mtx);
-        entries = move(new_entries);
+    struct ReconcileTask {
+        string dir;
+        size_t root_index;
+        bool rescan;   // List the directory (mtime changed, racy, new or root)
+    };
+    struct ReconcileResult {
+        vector<Entry> added;
+        vector<pair<Entry*, Entry>> updated;
+        vector<Entry*> removed;           // Stored children no longer present
+        vector<string> removed_subtrees;  // Stored directories whose contents are gone
+        size_t dirs_listed = 0;
+        size_t dirs_skipped = 0;
+    };
+    
+    deque<ReconcileTask> queue;
+    mutex queue_mtx;
+    condition_variable queue_cv;
+    size_t busy = 0;
+    for (size_t r = 0; r < root_paths.size(); r++) {
+        queue.push_back({root_paths[r], r, true});
     }
     
-    // Mark changes for flushing
+    // path_index keys have no trailing slash (the "/" root is the empty key)
+    auto stored_children = [](const string& dir) -> const vector<Entry*>* {
+        auto it = path_index.dir_to_entries.find(dir.ends_with('/') ? dir.substr(0, dir.size() - 1) : dir);
+        return it == path_index.dir_to_entries.end() ? nullptr : &it->second;
+    };
+    
+    auto process = [&](const ReconcileTask& task, ReconcileResult& res, vector<ReconcileTask>& next) {
+        const vector<Entry*>* children = stored_children(task.dir);
+        
+        if (!task.rescan) {
+            // Directory listing unchanged: only subdirectories need checking
+            res.dirs_skipped++;
+            if (!children) return;
+            for (Entry* child : *children) {
+                if (!child->is_dir || removed_flag[child - entries.data()]) continue;
+                struct stat st {};
+                if (lstat(child->path.c_str(), &st) != 0) continue;
+                if (!S_ISDIR(st.st_mode)) {
+                    Entry e = *child;
+                    e.is_dir = false;
+                    e.size = st.st_size;
+                    e.mtime = st.st_mtime;
+                    res.updated.emplace_back(child, e);
+                    res.removed_subtrees.push_back(child->path.str());
+                    continue;
+                }
+                bool changed = child->mtime != st.st_mtime;
+                if (changed) {
+                    Entry e = *child;
+                    e.mtime = st.st_mtime;
+                    res.updated.emplace_back(child, e);
+                }
+                next.push_back({child->path.str(), task.root_index, changed || racy(child)});
+            }
+            return;
+        }
+        
+        res.dirs_listed++;
+        unordered_map<string_view, Entry*> by_name;
+        if (children) {
+            by_name.reserve(children->size());
+            for (Entry* child : *children) {
+                by_name.emplace(dir_base_name(child->path), child);
+            }
+        }
+        
+        DIR* d = opendir(task.dir.c_str());
+        if (d) {
+            string p;
+            while (struct dirent* de = readdir(d)) {
+                if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+                p.assign(task.dir);
+                if (!task.dir.ends_with('/')) p += '/';
+                p += de->d_name;
+                
+                Entry* stored = nullptr;
+                auto it = by_name.find(string_view(de->d_name));
+                if (it != by_name.end()) {
+                    stored = it->second;
+                    by_name.erase(it);  // Seen on disk
+                }
+                
+                struct stat st {};
+                if (lstat(p.c_str(), &st) != 0) continue;  // Vanished mid-walk: keep what we had
+                
+                bool is_dir = S_ISDIR(st.st_mode);
+                Entry e;
+                e.path = p;
+                e.size = is_dir ? 0LL : st.st_size;
+                e.mtime = st.st_mtime;
+                e.is_dir = is_dir;
+                e.root_index = task.root_index;
+                
+                if (!stored) {
+                    res.added.push_back(e);
+                } else if (stored->size != e.size || stored->mtime != e.mtime ||
+                           stored->is_dir != e.is_dir || stored->root_index != e.root_index) {
+                    res.updated.emplace_back(stored, e);
+                }
+                
+                if (stored && stored->is_dir && !is_dir) {
+                    res.removed_subtrees.push_back(p);
+                }
+                if (is_dir) {
+                    bool rescan = !stored || !stored->is_dir || stored->mtime != e.mtime || racy(stored);
+                    next.push_back({p, task.root_index, rescan});
+                }
+            }
+            closedir(d);
+        }
+        
+        // Whatever is left was stored but is no longer in the directory
+        for (auto& [name, child] : by_name) {
+            if (removed_flag[child - entries.data()]) continue;
+            res.removed.push_back(child);
+            if (child->is_dir) res.removed_subtrees.push_back(child->path.str());
+        }
+    };
+    
+    size_t num_threads = thread::hardware_concurrency();
+    if (num_threads == 0) num_threads = 4;
+    vector<ReconcileResult> results(num_threads);
+    vector<thread> workers;
+    for (size_t t = 0; t < num_threads; t++) {
+        workers.emplace_back([&, t]() {
+            vector<ReconcileTask> next;
+            unique_lock<mutex> lk(queue_mtx);
+            while (true) {
+                queue_cv.wait(lk, [&] { return !queue.empty() || busy == 0 || !running; });
+                if (queue.empty() || !running) break;  // Done, or shutting down
+                ReconcileTask task = move(queue.front());
+                queue.pop_front();
+                busy++;
+                lk.unlock();
+                
+                next.clear();
+                try {
+                    process(task, results[t], next);
+                } catch (...) {}
+                
+                lk.lock();
+                busy--;
+                for (auto& n : next) queue.push_back(move(n));
+                queue_cv.notify_all();
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    if (!running) return;  // Shutdown mid-walk: the index stays incomplete
+    
+    // Merge the per-thread results
+    int added = 0, updated = static_cast<int>(updates.size());
+    size_t dirs_listed = 0, dirs_skipped = 0;
+    vector<Entry> new_entries;
+    vector<string> removed_subtrees;
+    for (auto& res : results) {
+        for (auto& u : res.updated) updates.push_back(move(u));
+        for (auto& e : res.added) new_entries.push_back(move(e));
+        for (Entry* e : res.removed) removed_flag[e - entries.data()] = 1;
+        for (auto& dir : res.removed_subtrees) removed_subtrees.push_back(move(dir));
+        updated += res.updated.size();
+        added += res.added.size();
+        dirs_listed += res.dirs_listed;
+        dirs_skipped += res.dirs_skipped;
+    }
+    
+    // Everything below a directory that vanished (or became a file) goes too
+    vector<string> stack(removed_subtrees.begin(), removed_subtrees.end());
+    while (!stack.empty()) {
+        string dir = move(stack.back());
+        stack.pop_back();
+        const vector<Entry*>* children = stored_children(dir);
+        if (!children) continue;
+        for (Entry* child : *children) {
+            removed_flag[child - entries.data()] = 1;
+            if (child->is_dir) stack.push_back(child->path.str());
+        }
+    }
+    for (char f : removed_flag) removed += f;
+    
+    // Apply the differences and record them for the next flush
     int total_changes = added + removed + updated;
     if (total_changes > 0) {
+        lock_guard<mutex> lk(mtx);
+        for (auto& [target, e] : updates) {
+            if (removed_flag[target - entries.data()]) continue;
+            *target = move(e);
+            mark_dirty_upsert(*target);
+        }
+        size_t out = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (removed_flag[i]) {
+                mark_dirty_delete(entries[i].path);
+                continue;
+            }
+            if (out != i) entries[out] = move(entries[i]);
+            out++;
+        }
+        entries.resize(out);
+        for (auto& e : new_entries) {
+            mark_dirty_upsert(e);
+            entries.push_back(move(e));
+        }
+        path_index_valid = false;  // Entry pointers moved
+        note_index_reset();
+        
         pending_changes += total_changes;
         db_dirty = true;
     }
     
-    if (foreground && (added > 0 || removed > 0 || updated > 0)) {
-        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Reconciliation: " 
-             << added << " added, " << removed << " removed, " << updated << " updated\n";
+    if (foreground) {
+        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Reconciliation: listed " << dirs_listed 
+             << " changed directories, skipped " << dirs_skipped << " unchanged\n";
+        if (total_changes > 0) {
+            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Reconciliation: " 
+                 << added << " added, " << removed << " removed, " << updated << " updated\n";
+        }
     }
 }
 
+/**
+ * Function: flush_changes_to_db
+ * Purpose: Persist pending index changes to SQLite
+ * Parameters: None
+ * Returns: void
+ * Thread-safety: Serialized by db_mtx; holds mtx only to take the dirty set
+ *                or snapshot the index, never while SQLite is writing
+ * 
+ * Normally only the dirty set is written, using prepared UPSERT and DELETE
+ * statements, so a flush costs O(changes) instead of O(index size). The
+ * whole table is rewritten only after a fresh full index (db_full_rewrite),
+ * from a copy of the index taken under the lock.
+ * If the transaction fails, the taken records are merged back so the next
+ * flush retries them (newer changes for the same path win).
+ * 
+ * Called from the db_writer thread while the daemon runs, and once more
+ * from main() at shutdown after the writer has stopped.
+ */
 void flush_changes_to_db() {
     if (!db) return;
     
@@ -839,6 +1756,45 @@ void flush_changes_to_db() {
     // Capture current pending changes before any operations
     int changes_to_flush = pending_changes.load();
     
+    // Take ownership of the dirty set (O(1) swap under the index lock), or
+    // copy the index for a full rewrite. SQLite never runs under mtx.
+    unordered_map<string, DirtyRecord> batch;
+    vector<pair<string, DirtyRecord>> snapshot;
+    bool full_rewrite = false;
+    uint64_t flush_seq = 0;  // Every journal record up to here is in this batch
+    {
+        lock_guard<mutex> entries_lk(mtx);
+        {
+            lock_guard<mutex> journal_lk(journal_mtx);
+            flush_seq = journal_seq;
+        }
+        batch.swap(dirty_entries);
+        full_rewrite = db_full_rewrite;
+        db_full_rewrite = false;
+        if (full_rewrite) {
+            snapshot.reserve(entries.size());
+            for (const auto& e : entries) {
+                snapshot.emplace_back(e.path, DirtyRecord{false, e.size, e.mtime, e.is_dir, e.root_index});
+            }
+        }
+    }
+    
+    if (batch.empty() && !full_rewrite) return;  // Nothing changed since the last flush
+    
+    // Put the batch back if it could not be committed
+    auto restore_batch = [&]() {
+        lock_guard<mutex> entries_lk(mtx);
+        if (full_rewrite) {
+            db_full_rewrite = true;
+            dirty_entries.clear();
+            return;
+        }
+        if (db_full_rewrite) return;
+        for (auto& [path, rec] : batch) {
+            dirty_entries.try_emplace(path, rec);
+        }
+    };
+    
     char* err_msg = nullptr;
     int rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, &err_msg);
     if (rc != SQLITE_OK) {
@@ -846,60 +1802,156 @@ void flush_changes_to_db() {
             cerr << COLOR_YELLOW << "Warning: Could not begin transaction: " << err_msg << COLOR_RESET << "\n";
         }
         sqlite3_free(err_msg);
+        restore_batch();
         return;
     }
     
-    // Clear existing entries
-    sqlite3_exec(db, "DELETE FROM entries;", nullptr, nullptr, nullptr);
-    
-    // Insert all current entries
-    sqlite3_stmt* stmt;
-    const char* sql = "INSERT INTO entries (path, size, mtime, is_dir, root_index) VALUES (?, ?, ?, ?, ?)";
+    // Rows are keyed by (parent directory id, basename); see init_database
+    const char* sql[] = {
+        "INSERT INTO dir_entries (dir_id, name, size, mtime, is_dir, root_index) VALUES (?, ?, ?, ?, ?, ?) "
+        "ON CONFLICT(dir_id, name) DO UPDATE SET size = excluded.size, mtime = excluded.mtime, "
+        "is_dir = excluded.is_dir, root_index = excluded.root_index",
+        "DELETE FROM dir_entries WHERE dir_id = ? AND name = ?",
+        "SELECT id FROM dirs WHERE path = ?",
+        "INSERT INTO dirs (path) VALUES (?)",
+        "DELETE FROM dirs WHERE path = ? AND NOT EXISTS (SELECT 1 FROM dir_entries WHERE dir_id = dirs.id)",
+    };
+    constexpr size_t NUM_STMTS = sizeof(sql) / sizeof(sql[0]);
+    sqlite3_stmt* stmts[NUM_STMTS] = {};
+    sqlite3_stmt*& upsert_stmt = stmts[0];
+    sqlite3_stmt*& delete_stmt = stmts[1];
+    sqlite3_stmt*& dir_select_stmt = stmts[2];
+    sqlite3_stmt*& dir_insert_stmt = stmts[3];
+    sqlite3_stmt*& dir_gc_stmt = stmts[4];
+    auto finalize_all = [&]() {
+        for (auto* st : stmts) sqlite3_finalize(st);
+    };
     
-    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        if (foreground) {
-            cerr << COLOR_YELLOW << "Warning: Could not prepare insert statement: "
-                 << sqlite3_errmsg(db) << COLOR_RESET << "\n";
+    for (size_t i = 0; i < NUM_STMTS; i++) {
+        if (sqlite3_prepare_v2(db, sql[i], -1, &stmts[i], nullptr) != SQLITE_OK) {
+            if (foreground) {
+                cerr << COLOR_YELLOW << "Warning: Could not prepare flush statements: "
+                     << sqlite3_errmsg(db) << COLOR_RESET << "\n";
+            }
+            finalize_all();
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            restore_batch();
+            return;
         }
-        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
-        return;
     }
     
-    int insert_count = 0;
+    int upsert_count = 0;
+    int delete_count = 0;
     int error_count = 0;
-    {
-        lock_guard<mutex> entries_lk(mtx);
-        for (const auto& e : entries) {
-            sqlite3_bind_text(stmt, 1, e.path.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_int64(stmt, 2, e.size);
-            sqlite3_bind_int64(stmt, 3, e.mtime);
-            sqlite3_bind_int(stmt, 4, e.is_dir ? 1 : 0);
-            sqlite3_bind_int(stmt, 5, e.root_index);
-            
-            rc = sqlite3_step(stmt);
-            if (rc == SQLITE_DONE) {
-                insert_count++;
-            } else {
-                error_count++;
-                if (foreground && error_count <= 5) {  // Limit error messages
-                    cerr << COLOR_YELLOW << "Warning: Failed to insert entry " << e.path 
-                         << ": " << sqlite3_errmsg(db) << COLOR_RESET << "\n";
+    
+    // Directory ids are looked up (or created) once per flush
+    unordered_map<string, sqlite3_int64> dir_ids;
+    auto dir_id_for = [&](const string& dir, bool create) -> sqlite3_int64 {
+        auto it = dir_ids.find(dir);
+        if (it != dir_ids.end()) return it->second;
+        sqlite3_int64 id = 0;
+        sqlite3_bind_text(dir_select_stmt, 1, dir.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(dir_select_stmt) == SQLITE_ROW) {
+            id = sqlite3_column_int64(dir_select_stmt, 0);
+        }
+        sqlite3_reset(dir_select_stmt);
+        if (id == 0 && create) {
+            sqlite3_bind_text(dir_insert_stmt, 1, dir.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(dir_insert_stmt) == SQLITE_DONE) id = sqlite3_last_insert_rowid(db);
+            sqlite3_reset(dir_insert_stmt);
+        }
+        if (id != 0) dir_ids.emplace(dir, id);
+        return id;
+    };
+    
+    // Split "/a/b/c" into parent "/a/b" and name "c" ("/c" has parent "")
+    auto split_path = [](const string& path, string& dir, const char*& name) {
+        size_t slash = path.rfind('/');
+        if (slash == string::npos) return false;
+        dir.assign(path, 0, slash);
+        name = path.c_str() + slash + 1;
+        return true;
+    };
+    string dir;
+    const char* name = nullptr;
+    
+    auto upsert = [&](const string& path, int64_t size, time_t mtime, bool is_dir, size_t root_index) {
+        sqlite3_int64 dir_id = 0;
+        if (split_path(path, dir, name)) dir_id = dir_id_for(dir, true);
+        if (dir_id == 0) {
+            error_count++;
+            return;
+        }
+        sqlite3_bind_int64(upsert_stmt, 1, dir_id);
+        sqlite3_bind_text(upsert_stmt, 2, name, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(upsert_stmt, 3, size);
+        sqlite3_bind_int64(upsert_stmt, 4, mtime);
+        sqlite3_bind_int(upsert_stmt, 5, is_dir ? 1 : 0);
+        sqlite3_bind_int(upsert_stmt, 6, root_index);
+        
+        rc = sqlite3_step(upsert_stmt);
+        if (rc == SQLITE_DONE) {
+            upsert_count++;
+        } else {
+            error_count++;
+            if (foreground && error_count <= 5) {  // Limit error messages
+                cerr << COLOR_YELLOW << "Warning: Failed to insert entry " << path 
+                     << ": " << sqlite3_errmsg(db) << COLOR_RESET << "\n";
+            }
+        }
+        sqlite3_reset(upsert_stmt);
+    };
+    
+    if (full_rewrite) {
+        // Fresh index: replace the table contents in one pass
+        sqlite3_exec(db, "DELETE FROM dir_entries; DELETE FROM dirs;", nullptr, nullptr, nullptr);
+        for (const auto& [path, rec] : snapshot) {
+            upsert(path, rec.size, rec.mtime, rec.is_dir, rec.root_index);
+        }
+    } else {
+        for (const auto& [path, rec] : batch) {
+            if (rec.deleted) {
+                sqlite3_int64 dir_id = split_path(path, dir, name) ? dir_id_for(dir, false) : 0;
+                if (dir_id == 0) continue;  // Parent never stored, so neither was the row
+                sqlite3_bind_int64(delete_stmt, 1, dir_id);
+                sqlite3_bind_text(delete_stmt, 2, name, -1, SQLITE_STATIC);
+                if (sqlite3_step(delete_stmt) == SQLITE_DONE) {
+                    delete_count++;
+                } else {
+                    error_count++;
                 }
+                sqlite3_reset(delete_stmt);
+            } else {
+                upsert(path, rec.size, rec.mtime, rec.is_dir, rec.root_index);
             }
-            sqlite3_reset(stmt);
+        }
+        
+        // A deleted path may have been a directory; drop its row once empty
+        for (const auto& [path, rec] : batch) {
+            if (!rec.deleted) continue;
+            sqlite3_bind_text(dir_gc_stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+            sqlite3_step(dir_gc_stmt);
+            sqlite3_reset(dir_gc_stmt);
         }
     }
-    sqlite3_finalize(stmt);
+    finalize_all();
     
     if (error_count > 0 && foreground) {
-        cerr << COLOR_YELLOW << "Warning: " << error_count << " entries failed to insert" << COLOR_RESET << "\n";
+        cerr << COLOR_YELLOW << "Warning: " << error_count << " entries failed to persist" << COLOR_RESET << "\n";
     }
     
     // Update sync state
     sqlite3_exec(db, "UPDATE sync_state SET last_full_sync = strftime('%s', 'now'), dirty = 0 WHERE id = 1;",
                  nullptr, nullptr, nullptr);
     
+    // Advance the generation so snapshots written before this flush are
+    // rejected, and record which journal records this commit covers
+    uint64_t next_generation = db_generation.load() + 1;
+    string gen_sql = "INSERT INTO meta (key, value) VALUES ('generation', '" + to_string(next_generation) +
+                     "'), ('journal_seq', '" + to_string(flush_seq) +
+                     "') ON CONFLICT(key) DO UPDATE SET value = excluded.value;";
+    sqlite3_exec(db, gen_sql.c_str(), nullptr, nullptr, nullptr);
+    
     rc = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &err_msg);
     if (rc != SQLITE_OK) {
         if (foreground) {
@@ -907,8 +1959,11 @@ void flush_changes_to_db() {
         }
         sqlite3_free(err_msg);
         sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        restore_batch();
     } else {
         // Successfully committed - update counters
+        db_generation = next_generation;
+        journal_checkpoint_at(flush_seq);
         // Subtract the changes we flushed, but keep any new changes that came in during flush
         int current = pending_changes.load();
         pending_changes.fetch_sub(min(current, changes_to_flush));
@@ -916,23 +1971,17 @@ void flush_changes_to_db() {
         last_flush_time = chrono::steady_clock::now();
         
         if (foreground) {
-            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Flushed " << insert_count 
-                 << " entries to database\n";
+            if (full_rewrite) {
+                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Flushed " << upsert_count 
+                     << " entries to database\n";
+            } else if (upsert_count > 0 || delete_count > 0) {
+                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Flushed " << upsert_count 
+                     << " updated and " << delete_count << " deleted entries to database\n";
+            }
         }
     }
 }
 
-void maybe_flush_to_db() {
-    if (!db_enabled || !db) return;
-    
-    auto now = chrono::steady_clock::now();
-    auto elapsed = chrono::duration_cast<chrono::seconds>(now - last_flush_time).count();
-    
-    if (pending_changes >= FLUSH_THRESHOLD || elapsed >= FLUSH_INTERVAL_SEC) {
-        flush_changes_to_db();
-    }
-}
-
 string get_pid_file_path() {
     uid_t uid = getuid();
     if (uid == 0) {
@@ -1155,937 +2204,3659 @@ static bool safe_read_all(int fd, void* buf, size_t count) {
     return true;
 }
 
-/**
- * Helper: ignore_write_result
- * Purpose: Wrapper to explicitly ignore write() return value in signal handlers
- * This is needed because newer GCC doesn't suppress warn_unused_result with (void) cast
+/*
+ * Binary index snapshot
+ * ---------------------
+ * Written next to the database as "<db>.snap" on clean shutdown and after
+ * flushes (at most every SNAPSHOT_INTERVAL_SEC), and mapped on startup:
+ * restored entries borrow their paths from the arena, so a restart neither
+ * steps through SQLite rows nor allocates per path. Layout (native byte
+ * order, 8-byte aligned):
+ *
+ *   SnapshotHeader
+ *   SnapshotEntry[entry_count]   entries grouped by parent directory
+ *   SnapshotDir[dir_count]       one range of entries per directory
+ *   arena[arena_size]            NUL-terminated paths; a directory name is
+ *                                the prefix of its first entry's path
+ *
+ * records_checksum covers the entry and directory tables, which are read
+ * (and checked) before the daemon starts serving. arena_checksum covers the
+ * paths; it is checked by the loader thread afterwards, so arena pages are
+ * not faulted in on the startup path. The snapshot is only used when its
+ * generation equals the database's, i.e. nothing was flushed after it was
+ * written; otherwise the daemon falls back to SQLite.
  */
-__attribute__((unused)) static inline void ignore_write_result(ssize_t result) {
-    (void)result;
-}
+constexpr char SNAPSHOT_MAGIC[8] = {'F', 'F', 'I', 'N', 'D', 'S', 'N', 'P'};
+constexpr uint32_t SNAPSHOT_VERSION = 2;
 
-// Helper function to clean up resources on socket creation/setup errors
-void cleanup_on_socket_error(int srv_fd, bool unlink_socket, const string& sock_path) {
-    // Close socket file descriptor if valid
-    if (srv_fd >= 0) {
-        close(srv_fd);
-    }
-    
-    // Remove socket file if requested
-    if (unlink_socket) {
-        unlink(sock_path.c_str());
-    }
-    
-    // Close database connection if open
-    if (db_enabled && db != nullptr) {
-        sqlite3_close(db);
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t generation;
+    uint64_t entry_count;
+    uint64_t dir_count;
+    uint64_t arena_size;
+    uint64_t records_checksum;
+    uint64_t arena_checksum;
+};
+
+struct SnapshotEntry {
+    uint64_t path_off;
+    uint32_t path_len;
+    uint32_t is_dir;
+    int64_t size;
+    int64_t mtime;
+    uint64_t root_index;
+};
+
+struct SnapshotDir {
+    uint64_t path_off;
+    uint64_t path_len;
+    uint64_t first_entry;
+    uint64_t entry_count;
+};
+
+static_assert(sizeof(SnapshotHeader) % 8 == 0 && sizeof(SnapshotEntry) % 8 == 0 &&
+              sizeof(SnapshotDir) % 8 == 0, "snapshot records must stay 8-byte aligned");
+
+// Snapshot mapped by load_index_snapshot(). Restored entries point into its
+// arena, so it stays mapped for the daemon's lifetime (client threads may
+// still be reading paths at exit); the file itself is only ever replaced by
+// rename, never rewritten in place.
+struct MappedSnapshot {
+    const char* base = nullptr;
+    size_t size = 0;
+    SnapshotHeader hdr {};
+    const SnapshotEntry* recs = nullptr;
+    const SnapshotDir* dirs = nullptr;
+    const char* arena = nullptr;
+};
+MappedSnapshot mapped_snapshot;
+
+// 64-bit FNV-1a style hash over 8-byte words (len must be a multiple of 8)
+static uint64_t snapshot_checksum(uint64_t h, const void* data, size_t len) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+        h ^= h >> 29;
     }
-    
-    // Close inotify file descriptor
-    close(in_fd);
-    
-    // Remove PID file
-    cleanup_pid_file();
+    return h;
+}
+
+string snapshot_path() {
+    return db_path + ".snap";
 }
 
 /**
- * Function: crash_handler
- * Purpose: Emergency cleanup on fatal signals (SIGSEGV, SIGABRT, SIGBUS)
- * Parameters:
- *   - sig: Signal number that triggered the crash
- * Returns: Does not return (re-raises signal after cleanup)
- * Security: 
- *   - CRITICAL: Only uses async-signal-safe functions
- *   - write() - async-signal-safe per POSIX
- *   - close() - async-signal-safe per POSIX
- *   - unlink() - async-signal-safe per POSIX
- *   - signal(), raise() - async-signal-safe per POSIX
- *   - std::atomic - NOT guaranteed async-signal-safe, but lock-free operations
- *     typically compile to single instructions (documented risk accepted)
- *   - NEVER calls: malloc, free, printf, C++ iostreams, sqlite3 functions
- * Thread-safety: Called from signal context (any thread)
+ * Function: write_index_snapshot
+ * Purpose: Atomically write the in-memory index to the binary snapshot
+ * Parameters: None
+ * Returns: true if the snapshot was written
+ * Thread-safety: db_writer thread, or main() once it has stopped (flushes
+ *                must not run meanwhile); takes mtx while serializing, file
+ *                I/O runs without it
  * 
- * REVIEWER_NOTE: This function runs in signal context with severe restrictions.
- * Only async-signal-safe functions are allowed. Any violation can cause deadlock
- * or corruption. The use of std::atomic is a documented implementation choice
- * that works in practice but is not guaranteed by standards.
+ * Skipped when the dirty set is not empty, because the snapshot must match
+ * the database at db_generation exactly. The file is written to a temporary
+ * name, fsynced and renamed over the old snapshot, so a crash leaves either
+ * the old or the new file, never a torn one, and a mapping of the old file
+ * (see MappedSnapshot) stays valid.
  */
-void crash_handler(int sig) {
-    // Use async-signal-safe functions only
-    const char* msg = nullptr;
-    size_t len = 0;
-    switch(sig) {
-        case SIGSEGV:
-            msg = "\n[CRASH] Segmentation fault - attempting emergency cleanup...\n";
-            len = sizeof("\n[CRASH] Segmentation fault - attempting emergency cleanup...\n") - 1;
-            break;
-        case SIGABRT:
-            msg = "\n[CRASH] Abort signal - attempting emergency cleanup...\n";
-            len = sizeof("\n[CRASH] Abort signal - attempting emergency cleanup...\n") - 1;
-            break;
-        case SIGBUS:
-            msg = "\n[CRASH] Bus error - attempting emergency cleanup...\n";
-            len = sizeof("\n[CRASH] Bus error - attempting emergency cleanup...\n") - 1;
-            break;
-        default:
-            msg = "\n[CRASH] Fatal signal - attempting emergency cleanup...\n";
-            len = sizeof("\n[CRASH] Fatal signal - attempting emergency cleanup...\n") - 1;
-            break;
+bool write_index_snapshot() {
+    if (!db_enabled || db_path.empty()) return false;
+    
+    SnapshotHeader hdr {};
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.header_size = sizeof(SnapshotHeader);
+    hdr.generation = db_generation.load();
+    
+    vector<SnapshotEntry> recs;
+    vector<SnapshotDir> dirs;
+    string arena;
+    {
+        lock_guard<mutex> lk(mtx);
+        if (!dirty_entries.empty() || db_full_rewrite) return false;
+        
+        size_t arena_bytes = 0;
+        for (const auto& e : entries) arena_bytes += e.path.size() + 1;
+        arena.reserve(arena_bytes + 8);
+        recs.reserve(entries.size());
+        dirs.reserve(path_index.dir_to_entries.size());
+        
+        auto add_entry = [&](const Entry& e) {
+            SnapshotEntry r {};
+            r.path_off = arena.size();
+            r.path_len = static_cast<uint32_t>(e.path.size());
+            r.is_dir = e.is_dir ? 1 : 0;
+            r.size = e.size;
+            r.mtime = e.mtime;
+            r.root_index = e.root_index;
+            arena.append(e.path);
+            arena.push_back('\0');
+            recs.push_back(r);
+        };
+        
+        for (const auto& [dir, dir_entries] : path_index.dir_to_entries) {
+            if (dir_entries.empty()) continue;
+            SnapshotDir d {};
+            d.first_entry = recs.size();
+            d.entry_count = dir_entries.size();
+            for (const Entry* e : dir_entries) add_entry(*e);
+            d.path_off = recs[d.first_entry].path_off;
+            d.path_len = dir.size();
+            dirs.push_back(d);
+        }
+        // Entries without a parent directory are not in the path index
+        for (const auto& e : entries) {
+            if (e.path.rfind('/') == string::npos) add_entry(e);
+        }
+        
+        if (recs.size() != entries.size()) return false;  // Path index out of sync
     }
-    if (msg != nullptr && len > 0) {
-        // SECURITY: Signal handler safety - write() is async-signal-safe
-        // Intentionally ignore return value (can't handle errors in crash handler)
-        ignore_write_result(write(STDERR_FILENO, msg, len));
+    arena.resize((arena.size() + 7) & ~size_t(7), '\0');
+    
+    hdr.entry_count = recs.size();
+    hdr.dir_count = dirs.size();
+    hdr.arena_size = arena.size();
+    uint64_t h = 0xcbf29ce484222325ULL;
+    h = snapshot_checksum(h, recs.data(), recs.size() * sizeof(SnapshotEntry));
+    hdr.records_checksum = snapshot_checksum(h, dirs.data(), dirs.size() * sizeof(SnapshotDir));
+    hdr.arena_checksum = snapshot_checksum(0xcbf29ce484222325ULL, arena.data(), arena.size());
+    
+    string final_path = snapshot_path();
+    string tmp_path = final_path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        if (foreground) {
+            cerr << COLOR_YELLOW << "Warning: Could not create index snapshot: " << strerror(errno) << COLOR_RESET << "\n";
+        }
+        return false;
     }
     
-    // NOTE: We use atomic operations here as best-effort cleanup.
-    // While C++ std::atomic is not guaranteed async-signal-safe by the standard,
-    // lock-free atomic operations typically compile to single instructions.
-    // In a crash scenario, we accept this for best-effort cleanup.
-    
-    // Close socket (best effort)
-    int fd = srv_fd.exchange(-1);
-    if (fd >= 0) {
-        close(fd);
-    }
+    bool ok = safe_write_all(fd, &hdr, sizeof(hdr)) &&
+              safe_write_all(fd, recs.data(), recs.size() * sizeof(SnapshotEntry)) &&
+              safe_write_all(fd, dirs.data(), dirs.size() * sizeof(SnapshotDir)) &&
+              safe_write_all(fd, arena.data(), arena.size()) &&
+              fsync(fd) == 0;
+    close(fd);
     
-    // Remove socket file (best effort)
-    if (sock_path_buf[0] != '\0') {
-        unlink(sock_path_buf);
+    if (!ok || rename(tmp_path.c_str(), final_path.c_str()) != 0) {
+        if (foreground) {
+            cerr << COLOR_YELLOW << "Warning: Could not write index snapshot: " << strerror(errno) << COLOR_RESET << "\n";
+        }
+        unlink(tmp_path.c_str());
+        return false;
     }
     
-    // Remove PID file (best effort)
-    if (pid_file_path_buf[0] != '\0') {
-        unlink(pid_file_path_buf);
+    // Make the rename itself durable
+    string dir = path(final_path).parent_path().string();
+    int dir_fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
     }
     
-    // Note: Do NOT close database here - sqlite3_close() is not async-signal-safe
-    // WAL mode will handle recovery on next startup
+    snapshot_generation = static_cast<int64_t>(hdr.generation);
     
-    // Restore default handler and re-raise for core dump
-    signal(sig, SIG_DFL);
-    raise(sig);
+    if (foreground) {
+        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Wrote index snapshot (" << recs.size() 
+             << " entries)\n";
+    }
+    return true;
 }
 
 /**
- * Function: sig_handler
- * Purpose: Graceful shutdown handler for SIGINT and SIGTERM
- * Parameters:
- *   - sig: Signal number (unused, suppressed with (void)sig)
+ * Function: maybe_write_index_snapshot
+ * Purpose: Refresh the snapshot after a flush, so a restart after a crash
+ *          does not have to fall back to loading SQLite rows
+ * Parameters: None
  * Returns: void
- * Security:
- *   - CRITICAL: Only uses async-signal-safe functions
- *   - write() - async-signal-safe per POSIX
- *   - close() - async-signal-safe per POSIX  
- *   - std::atomic::exchange() - NOT guaranteed async-signal-safe, but lock-free
- *     operations typically compile to single instructions (documented risk)
- *   - NEVER calls: malloc, free, printf, C++ iostreams, sqlite3 functions
- * Thread-safety: Called from signal context (any thread)
+ * Thread-safety: db_writer thread only
  * 
- * Implementation Notes:
- * - Sets atomic flag to initiate graceful shutdown
- * - Closes server socket to unblock accept() call in main thread
- * - Main thread polls the 'running' flag and performs full cleanup
- * - Database writes happen in main thread, not here
+ * Runs when the database has moved past the snapshot on disk, at most once
+ * per SNAPSHOT_INTERVAL_SEC: writing it copies the whole index under mtx.
+ */
+void maybe_write_index_snapshot() {
+    if (static_cast<int64_t>(db_generation.load()) == snapshot_generation) return;
+    auto now = chrono::steady_clock::now();
+    if (last_snapshot_time != chrono::steady_clock::time_point{} &&
+        now - last_snapshot_time < chrono::seconds(SNAPSHOT_INTERVAL_SEC)) {
+        return;
+    }
+    // A snapshot is refused while changes are waiting for the next flush;
+    // try again after that flush rather than waiting out the interval
+    if (write_index_snapshot()) last_snapshot_time = now;
+}
+
+/**
+ * Function: load_index_snapshot
+ * Purpose: Restore entries from the binary snapshot without copying paths
+ * Parameters: None
+ * Returns: true if the snapshot was accepted; false to fall back to
+ *          load_entries_from_db()
+ * Security: Every offset and count is bounds-checked against the mapping
+ *           and the record tables are checksummed before any entry is built
  * 
- * REVIEWER_NOTE: This handler sets flags and closes FDs to wake the main thread.
- * All complex cleanup happens in the main thread after detecting shutdown.
+ * The file is mapped read-only and kept mapped (see MappedSnapshot). Only
+ * the entry and directory tables are read here; each Entry borrows its path
+ * from the arena, whose pages are faulted in when a path is first used. The
+ * arena checksum and the path index are left to verify_index_snapshot(),
+ * which runs on the loader thread while queries are already served. The
+ * arena must end in a NUL byte, so a path read before that check can never
+ * run past the mapping.
  */
-void sig_handler(int sig) {
-    (void)sig;  // Unused parameter
+bool load_index_snapshot() {
+    if (!db_enabled || db_path.empty()) return false;
     
-    // NOTE: We use C++ std::atomic operations here. While not guaranteed
-    // async-signal-safe by POSIX/C++ standards, lock-free atomic operations
-    // on modern platforms typically compile to single instructions and work
-    // reliably in practice. This is a documented implementation choice.
+    int fd = open(snapshot_path().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
     
-    // Only print once using global atomic
-    if (shutdown_started.exchange(true) == false) {
-        const char msg[] = "\n[INFO] Shutdown signal received, stopping gracefully...\n";
-        // SECURITY: Signal handler safety - write() is async-signal-safe
-        // Intentionally ignore return value (can't handle errors in signal handler)
-        ignore_write_result(write(STDERR_FILENO, msg, sizeof(msg)-1));
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SnapshotHeader))) {
+        close(fd);
+        return false;
     }
+    size_t file_size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
     
-    running = 0; 
+    auto reject = [&](const char* why) {
+        if (foreground) {
+            cerr << COLOR_YELLOW << "[WARNING]" << COLOR_RESET << " Ignoring index snapshot: " << why << "\n";
+        }
+        munmap(map, file_size);
+        return false;
+    };
     
-    // Close socket to unblock accept()
-    int fd = srv_fd.exchange(-1);  // Atomically get and set to -1
-    if (fd >= 0) {
-        shutdown(fd, SHUT_RDWR);  // Unblock accept() immediately
-        close(fd);
+    const char* base = static_cast<const char*>(map);
+    SnapshotHeader hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+    if (memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != SNAPSHOT_VERSION || hdr.header_size != sizeof(SnapshotHeader)) {
+        return reject("unknown format");
+    }
+    if (hdr.generation != db_generation.load()) {
+        return reject("older than database");
+    }
+    
+    // Section sizes must add up to the file size exactly (checked without overflow)
+    size_t body = file_size - sizeof(SnapshotHeader);
+    if (hdr.entry_count > body / sizeof(SnapshotEntry)) return reject("truncated");
+    body -= hdr.entry_count * sizeof(SnapshotEntry);
+    if (hdr.dir_count > body / sizeof(SnapshotDir)) return reject("truncated");
+    body -= hdr.dir_count * sizeof(SnapshotDir);
+    if (hdr.arena_size != body || hdr.arena_size % 8 != 0) return reject("truncated");
+    
+    const char* payload = base + sizeof(SnapshotHeader);
+    size_t records_size = hdr.entry_count * sizeof(SnapshotEntry) + hdr.dir_count * sizeof(SnapshotDir);
+    if (snapshot_checksum(0xcbf29ce484222325ULL, payload, records_size) != hdr.records_checksum) {
+        return reject("checksum mismatch");
+    }
+    
+    const SnapshotEntry* recs = reinterpret_cast<const SnapshotEntry*>(payload);
+    const SnapshotDir* dirs = reinterpret_cast<const SnapshotDir*>(recs + hdr.entry_count);
+    const char* arena = reinterpret_cast<const char*>(dirs + hdr.dir_count);
+    
+    if (hdr.arena_size > 0 && arena[hdr.arena_size - 1] != '\0') return reject("corrupt arena");
+    for (uint64_t i = 0; i < hdr.entry_count; i++) {
+        if (recs[i].path_off >= hdr.arena_size || recs[i].path_len >= hdr.arena_size - recs[i].path_off) {
+            return reject("corrupt entry");
+        }
+    }
+    for (uint64_t i = 0; i < hdr.dir_count; i++) {
+        if (dirs[i].first_entry > hdr.entry_count || dirs[i].entry_count > hdr.entry_count - dirs[i].first_entry ||
+            dirs[i].path_off > hdr.arena_size || dirs[i].path_len > hdr.arena_size - dirs[i].path_off) {
+            return reject("corrupt directory");
+        }
+    }
+    
+    {
+        lock_guard<mutex> lk(mtx);
+        entries.clear();
+        entries.reserve(hdr.entry_count);
+        for (uint64_t i = 0; i < hdr.entry_count; i++) {
+            const SnapshotEntry& r = recs[i];
+            entries.push_back(Entry{EntryPath::borrow(arena + r.path_off, r.path_len), r.size,
+                                    static_cast<time_t>(r.mtime), r.is_dir != 0,
+                                    static_cast<size_t>(r.root_index)});
+        }
+        path_index.dir_to_entries.clear();
+        path_index.all_dirs.clear();
+        path_index_valid = false;
+        note_index_reset();
     }
+    mapped_snapshot = MappedSnapshot{base, file_size, hdr, recs, dirs, arena};
+    snapshot_generation = static_cast<int64_t>(hdr.generation);
     
-    // Note: PID file cleanup will happen in main() after signal handler sets running = 0
+    if (foreground) {
+        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Mapped " << hdr.entry_count 
+             << " entries from index snapshot\n";
+    }
+    return true;
 }
 
-// Helper function to find which root a path belongs to
-// Returns the index of the most specific (longest matching) root
-// Note: This function is only called with paths from inotify events, which should
-// always be under one of the monitored roots. If no match is found (best_len == 0),
-// this indicates a bug and we assert to catch it early.
-size_t find_root_index(const string& path) {
-    size_t best_idx = 0;
-    size_t best_len = 0;
+/**
+ * Function: verify_index_snapshot
+ * Purpose: Finish a snapshot restore: check the path arena, then rebuild
+ *          the path index from the stored directory ranges
+ * Parameters: None
+ * Returns: true if the arena is intact; false if the restored entries must
+ *          be replaced by load_entries_from_db()
+ * Thread-safety: db_loader thread (or main() when loading synchronously),
+ *                before anything but queries touches entries; takes mtx
+ *                to publish the path index
+ */
+bool verify_index_snapshot() {
+    const MappedSnapshot& snap = mapped_snapshot;
+    const SnapshotHeader& hdr = snap.hdr;
     
-    for (size_t i = 0; i < root_paths.size(); i++) {
-        if ((path == root_paths[i] || path.starts_with(root_paths[i])) && 
-            root_paths[i].size() > best_len) {
-            best_idx = i;
-            best_len = root_paths[i].size();
+    bool intact = snapshot_checksum(0xcbf29ce484222325ULL, snap.arena, hdr.arena_size) == hdr.arena_checksum;
+    for (uint64_t i = 0; intact && i < hdr.entry_count; i++) {
+        intact = snap.arena[snap.recs[i].path_off + snap.recs[i].path_len] == '\0';
+    }
+    if (!intact) {
+        if (foreground) {
+            cerr << COLOR_YELLOW << "[WARNING]" << COLOR_RESET
+                 << " Ignoring index snapshot: checksum mismatch in paths, loading database\n";
         }
+        snapshot_generation = -1;  // Rewrite it at the next opportunity
+        return false;
     }
     
-    // Assert that we found a matching root - this should always be true for paths
-    // from inotify events. If this assertion fails, it indicates a logic error.
-    assert(best_len > 0 && "Path does not belong to any monitored root");
-    
-    return best_idx;
+    lock_guard<mutex> lk(mtx);
+    path_index.dir_to_entries.clear();
+    path_index.all_dirs.clear();
+    path_index.dir_to_entries.reserve(hdr.dir_count);
+    for (uint64_t i = 0; i < hdr.dir_count; i++) {
+        const SnapshotDir& d = snap.dirs[i];
+        string dir(snap.arena + d.path_off, d.path_len);
+        auto& dir_entries = path_index.dir_to_entries[dir];
+        dir_entries.reserve(dir_entries.size() + d.entry_count);
+        for (uint64_t j = 0; j < d.entry_count; j++) {
+            dir_entries.push_back(&entries[d.first_entry + j]);
+        }
+        path_index.all_dirs.insert(move(dir));
+    }
+    path_index_valid = true;
+    note_index_reset();
+    return true;
 }
 
-void daemonize() {
-    pid_t pid = fork();
-    if (pid < 0) exit(1);
-    if (pid > 0) exit(0);
-    umask(0);
-    if (setsid() < 0) exit(1);
-    close(STDIN_FILENO);
-    close(STDOUT_FILENO);
-    close(STDERR_FILENO);
+/**
+ * Function: request_db_flush
+ * Purpose: Ask the background writer to run a flush
+ * Parameters: None
+ * Returns: void
+ * Thread-safety: Safe from any thread; requests made while a flush is
+ *                running coalesce into one follow-up flush
+ */
+void request_db_flush() {
+    {
+        lock_guard<mutex> lk(db_writer_mtx);
+        db_flush_requested = true;
+    }
+    db_writer_cv.notify_one();
 }
 
-void update_or_add(const string& full, size_t root_index) {
-    struct stat st {};
-    if (lstat(full.c_str(), &st) != 0) return;
+/**
+ * Function: db_writer_loop
+ * Purpose: Body of the db_writer thread; runs flushes on request
+ * Parameters: None
+ * Returns: void
+ * 
+ * Keeping SQLite off the event thread means a slow flush (fsync, lock
+ * contention on the database file) never delays inotify processing, and
+ * queries only ever wait for the short dirty set swap in
+ * flush_changes_to_db().
+ */
+void db_writer_loop() {
+    unique_lock<mutex> lk(db_writer_mtx);
+    while (true) {
+        db_writer_cv.wait(lk, [] { return db_flush_requested || db_writer_stop; });
+        if (db_writer_stop) break;
+        db_flush_requested = false;
+        lk.unlock();
+        flush_changes_to_db();
+        maybe_write_index_snapshot();
+        lk.lock();
+    }
+}
 
-    bool is_dir = S_ISDIR(st.st_mode);
-    int64_t sz = is_dir ? 0 : st.st_size;
+void start_db_writer() {
+    if (!db_enabled || !db) return;
+    db_writer = thread(db_writer_loop);
+}
 
-    lock_guard<mutex> lk(mtx);
-    auto it = find_if(entries.begin(), entries.end(), [&](const Entry& e){ return e.path == full; });
-    if (it != entries.end()) {
-        // Entry already exists - update it in place
-        it->size = sz;
-        it->mtime = st.st_mtime;
-        it->is_dir = is_dir;
-        it->root_index = root_index;
-        // Path index doesn't need updating since the entry location didn't change
-    } else {
-        // New entry - add to entries and rebuild path index
-        Entry e;
-        e.path = full;
-        e.size = sz;
-        e.mtime = st.st_mtime;
-        e.is_dir = is_dir;
-        e.root_index = root_index;
-        entries.push_back(e);
-        
-        // Rebuild path index to avoid dangling pointers from vector reallocation
-        // When entries vector reallocates, all stored pointers become invalid
-        path_index.dir_to_entries.clear();
-        path_index.all_dirs.clear();
-        
-        for (auto& entry : entries) {
-            size_t last_slash = entry.path.rfind('/');
-            if (last_slash != string::npos) {
-                string dir = entry.path.substr(0, last_slash);
-                path_index.dir_to_entries[dir].push_back(&entry);
-                path_index.all_dirs.insert(dir);
-            }
-        }
+// Stop the writer thread; any unflushed changes are left for the caller
+void stop_db_writer() {
+    if (!db_writer.joinable()) return;
+    {
+        lock_guard<mutex> lk(db_writer_mtx);
+        db_writer_stop = true;
     }
+    db_writer_cv.notify_one();
+    db_writer.join();
+}
+
+void maybe_flush_to_db() {
+    if (!db_enabled || !db) return;
     
-    // Mark DB as dirty if persistence is enabled
-    if (db_enabled) {
-        pending_changes++;
-        db_dirty = true;
+    auto now = chrono::steady_clock::now();
+    auto elapsed = chrono::duration_cast<chrono::seconds>(now - last_flush_time.load()).count();
+    
+    if (pending_changes >= FLUSH_THRESHOLD || (db_dirty && elapsed >= FLUSH_INTERVAL_SEC)) {
+        request_db_flush();
     }
 }
 
+string journal_path() {
+    return db_path + ".journal";
+}
+
 /**
- * Function: remove_path
- * Purpose: Remove a file or directory from the in-memory index
+ * Function: scan_journal
+ * Purpose: Walk the valid records of a journal image
  * Parameters:
- *   - full: Full absolute path to remove
- *   - recursive: If true, also removes all entries under this path (for directories)
- * Returns: void
- * Security:
- *   - Thread-safe: Uses mutex lock
- *   - Rebuilds path index after removal to maintain consistency
- *   - Updates database dirty flag if persistence is enabled
- * Thread-safety: Thread-safe (uses mtx)
+ *   - data: Whole journal file contents, header included
+ *   - fn: Called with each record header and its path
+ * Returns: Offset just past the last valid record; anything after it is a
+ *          torn or corrupt tail
+ * Security: Record lengths are bounds-checked and every record's checksum is
+ *           verified before fn sees it
+ */
+static size_t scan_journal(const string& data,
+                           const function<void(const JournalRecord&, string_view)>& fn) {
+    size_t off = JOURNAL_HEADER_SIZE;
+    while (data.size() - off >= sizeof(JournalRecord)) {
+        JournalRecord r;
+        memcpy(&r, data.data() + off, sizeof(r));
+        if (r.path_len == 0 || r.path_len > PATH_MAX || 
+            data.size() - off - sizeof(r) < r.path_len) {
+            break;
+        }
+        if (journal_checksum(data.data() + off + sizeof(uint32_t),
+                             sizeof(r) - sizeof(uint32_t) + r.path_len) != r.checksum) {
+            break;
+        }
+        fn(r, string_view(data.data() + off + sizeof(r), r.path_len));
+        off += sizeof(r) + r.path_len;
+    }
+    return off;
+}
+
+static string journal_header() {
+    string hdr(JOURNAL_HEADER_SIZE, '\0');
+    memcpy(hdr.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    memcpy(hdr.data() + sizeof(JOURNAL_MAGIC), &JOURNAL_VERSION, sizeof(JOURNAL_VERSION));
+    return hdr;
+}
+
+/**
+ * Function: replay_journal
+ * Purpose: Open the change journal and apply records newer than the database
+ * Parameters:
+ *   - apply: false after a fresh index, where old records are discarded
+ * Returns: true if the journal is open for appending
+ * Thread-safety: Startup only; takes mtx while applying records
  * 
- * Implementation Notes:
- * - For recursive removal, uses starts_with() to match all children
- * - Invalidates entry pointers when vector is modified
- * - Rebuilds entire path index for simplicity (could be optimized)
- * - Tracks removed count for database synchronization
+ * Records with seq <= meta.journal_seq were committed by a flush and are
+ * skipped. The rest are applied to entries (last record per path wins) and
+ * put back in the dirty set, so the next flush writes them to SQLite. A torn
+ * tail left by a crash is truncated before new records are appended after it.
  */
-void remove_path(const string& full, bool recursive = false) {
-    lock_guard<mutex> lk(mtx);
-    size_t count_before = entries.size();
-    if (recursive) {
-        entries.erase(remove_if(entries.begin(), entries.end(), [&](const Entry& e){
-            return e.path == full || e.path.starts_with(full + "/");
-        }), entries.end());
-    } else {
-        entries.erase(remove_if(entries.begin(), entries.end(), [&](const Entry& e){ return e.path == full; }), entries.end());
+bool replay_journal(bool apply) {
+    if (!db_enabled || db_path.empty()) return false;
+    
+    int fd = open(journal_path().c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        if (foreground) {
+            cerr << COLOR_YELLOW << "Warning: Could not open change journal: " << strerror(errno) << COLOR_RESET << "\n";
+        }
+        return false;
     }
     
-    // Mark DB as dirty if any entries were removed
-    size_t removed = count_before - entries.size();
-    if (db_enabled && removed > 0) {
-        pending_changes += removed;
-        db_dirty = true;
+    string data;
+    struct stat st {};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data.resize(static_cast<size_t>(st.st_size));
+        if (pread(fd, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size())) data.clear();
     }
     
-    // Rebuild path index since entry pointers may have been invalidated
-    // This is simpler than trying to maintain pointers during vector modifications
-    if (removed > 0) {
-        path_index.dir_to_entries.clear();
-        path_index.all_dirs.clear();
-        
-        for (auto& e : entries) {
-            size_t last_slash = e.path.rfind('/');
-            if (last_slash != string::npos) {
-                string dir = e.path.substr(0, last_slash);
-                path_index.dir_to_entries[dir].push_back(&e);
-                path_index.all_dirs.insert(dir);
-            }
-        }
+    string hdr = journal_header();
+    bool valid = data.size() >= JOURNAL_HEADER_SIZE && data.compare(0, JOURNAL_HEADER_SIZE, hdr) == 0;
+    if (!valid && !data.empty() && foreground) {
+        cerr << COLOR_YELLOW << "[WARNING]" << COLOR_RESET << " Discarding unreadable change journal\n";
     }
-}
-
-void handle_directory_rename(const string& old_path, const string& new_path) {
-    lock_guard<mutex> lk(mtx);
-    int updated = 0;
     
-    // Update all entry paths under the renamed directory
-    for (auto& e : entries) {
-        if (e.path == old_path || e.path.starts_with(old_path + "/")) {
-            e.path = new_path + e.path.substr(old_path.size());
-            updated++;
-        }
+    unordered_map<string, DirtyRecord, StringHash, equal_to<>> latest;
+    uint64_t max_seq = db_journal_seq;
+    size_t good_end = JOURNAL_HEADER_SIZE;
+    if (valid) {
+        good_end = scan_journal(data, [&](const JournalRecord& r, string_view path) {
+            max_seq = max(max_seq, r.seq);
+            if (!apply || r.seq <= db_journal_seq) return;
+            latest[string(path)] = DirtyRecord{r.deleted != 0, r.size, static_cast<time_t>(r.mtime),
+                                               r.is_dir != 0, r.root_index};
+        });
     }
     
-    // Update wd_to_dir mappings
-    for (auto& [wd, dir] : wd_to_dir) {
-        if (dir == old_path || dir.starts_with(old_path + "/")) {
-            dir = new_path + dir.substr(old_path.size());
+    // Drop a torn tail (or rewrite a missing/unknown header) before appending
+    if (!valid || !apply || good_end < data.size()) {
+        if (valid && apply && foreground) {
+            cerr << COLOR_YELLOW << "[WARNING]" << COLOR_RESET << " Discarded " << (data.size() - good_end)
+                 << " bytes of incomplete journal records\n";
+        }
+        size_t keep = (valid && apply) ? good_end : 0;
+        if (ftruncate(fd, static_cast<off_t>(keep)) != 0 ||
+            (keep == 0 && !safe_write_all(fd, hdr.data(), hdr.size())) || fdatasync(fd) != 0) {
+            close(fd);
+            return false;
         }
     }
     
-    // Rebuild path index since paths have changed
-    if (updated > 0) {
-        path_index.dir_to_entries.clear();
-        path_index.all_dirs.clear();
-        
-        for (auto& e : entries) {
-            size_t last_slash = e.path.rfind('/');
-            if (last_slash != string::npos) {
-                string dir = e.path.substr(0, last_slash);
-                path_index.dir_to_entries[dir].push_back(&e);
-                path_index.all_dirs.insert(dir);
+    if (!latest.empty()) {
+        lock_guard<mutex> lk(mtx);
+        size_t out = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            auto it = latest.find(entries[i].path.view());
+            if (it != latest.end()) {
+                const DirtyRecord& rec = it->second;
+                dirty_entries[it->first] = rec;
+                if (rec.deleted) {
+                    latest.erase(it);
+                    continue;
+                }
+                entries[i].size = rec.size;
+                entries[i].mtime = rec.mtime;
+                entries[i].is_dir = rec.is_dir;
+                entries[i].root_index = rec.root_index;
+                latest.erase(it);
             }
+            if (out != i) entries[out] = move(entries[i]);
+            out++;
+        }
+        entries.resize(out);
+        for (auto& [path, rec] : latest) {
+            dirty_entries[path] = rec;
+            if (!rec.deleted) entries.push_back(Entry{path, rec.size, rec.mtime, rec.is_dir, rec.root_index});
+        }
+        path_index_valid = false;
+        note_index_reset();
+        pending_changes += static_cast<int>(dirty_entries.size());
+        db_dirty = true;
+        
+        if (foreground) {
+            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Replayed " << dirty_entries.size() 
+                 << " changes from journal\n";
         }
     }
     
-    if (foreground) {
-        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory renamed: "
-             << COLOR_BOLD << old_path << COLOR_RESET << " -> "
-             << COLOR_BOLD << new_path << COLOR_RESET
-             << " (updated " << updated << " entries)\n";
-    }
-}
-
-void cleanup_stale_pending_moves() {
-    lock_guard<mutex> lk(pending_moves_mtx);
-    auto now = chrono::steady_clock::now();
-    for (auto it = pending_moves.begin(); it != pending_moves.end(); ) {
-        if (chrono::duration_cast<chrono::seconds>(now - it->second.second).count() > 1) {
-            // Stale move (moved out of watched tree) - treat as delete
-            const string& path = it->second.first;
-            
-            // Remove watch descriptors for the moved-out directory tree
-            for (auto wd_it = wd_to_dir.begin(); wd_it != wd_to_dir.end(); ) {
-                if (wd_it->second == path || wd_it->second.starts_with(path + "/")) {
-                    inotify_rm_watch(in_fd, wd_it->first);
-                    wd_it = wd_to_dir.erase(wd_it);
-                } else {
-                    ++wd_it;
-                }
-            }
-            
-            remove_path(path, true);  // Remove from entries
-            if (foreground) {
-                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory deleted: "
-                     << COLOR_BOLD << path << COLOR_RESET << " (moved out of tree)\n";
-            }
-            it = pending_moves.erase(it);
-        } else {
-            ++it;
-        }
+    {
+        lock_guard<mutex> lk(journal_mtx);
+        journal_seq = max_seq;
+        journal_checkpoint = db_journal_seq;
     }
+    journal_fd = fd;
+    journal_enabled = true;
+    return true;
 }
 
 /**
- * Function: add_watch
- * Purpose: Register an inotify watch on a directory
+ * Function: checkpoint_journal
+ * Purpose: Discard journal records that a flush has committed to SQLite
  * Parameters:
- *   - dir: Directory path to watch
+ *   - checkpoint_seq: Highest seq contained in the database
+ *   - written_seq: Highest seq written to the journal file so far
  * Returns: void
- * Security:
- *   - No validation of directory path (assumes caller validates)
- *   - Watch descriptor stored in global map
- * Thread-safety: Not thread-safe (called from single-threaded context during indexing)
+ * Thread-safety: journal_writer thread only (owns journal_fd)
  * 
- * REVIEWER_NOTE: This assumes inotify_add_watch() succeeds. Failed watches are
- * silently ignored (wd <= 0). This is acceptable as indexing continues without
- * real-time updates for that directory.
+ * The common case is that the flush covered everything written, and the
+ * file is truncated back to its header. Otherwise the uncommitted tail is
+ * copied into a fresh file, but only once the journal has grown past
+ * JOURNAL_COMPACT_BYTES; replay skips committed records anyway.
  */
-void add_watch(const string& dir) {
-    int wd = inotify_add_watch(in_fd, dir.c_str(),
-        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
-    if (wd > 0) wd_to_dir[wd] = dir;
+static void checkpoint_journal(uint64_t checkpoint_seq, uint64_t written_seq) {
+    if (checkpoint_seq >= written_seq) {
+        if (ftruncate(journal_fd, JOURNAL_HEADER_SIZE) == 0) fdatasync(journal_fd);
+        return;
+    }
+    
+    struct stat st {};
+    if (fstat(journal_fd, &st) != 0 || st.st_size < JOURNAL_COMPACT_BYTES) return;
+    
+    string data(static_cast<size_t>(st.st_size), '\0');
+    if (pread(journal_fd, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size())) return;
+    string kept = journal_header();
+    scan_journal(data, [&](const JournalRecord& r, string_view path) {
+        if (r.seq <= checkpoint_seq) return;
+        kept.append(reinterpret_cast<const char*>(&r), sizeof(r));
+        kept.append(path);
+    });
+    
+    string tmp_path = journal_path() + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+    if (!safe_write_all(fd, kept.data(), kept.size()) || fsync(fd) != 0 ||
+        rename(tmp_path.c_str(), journal_path().c_str()) != 0) {
+        close(fd);
+        unlink(tmp_path.c_str());
+        return;
+    }
+    close(journal_fd);
+    journal_fd = fd;
 }
 
 /**
- * Function: add_directory_recursive
- * Purpose: Recursively index a directory and all its subdirectories
- * Parameters:
- *   - dir: Directory path to index
- *   - root_index: Index of the root directory in the roots vector
+ * Function: journal_writer_loop
+ * Purpose: Body of the journal_writer thread (group commit)
+ * Parameters: None
  * Returns: void
- * Security:
- *   - Skips symlinks to prevent infinite loops
- *   - Exception-safe: catches all exceptions from directory iteration
- * Thread-safety: Not thread-safe (called during initial indexing or from event thread)
  * 
- * Implementation Notes:
- * - Adds inotify watch for real-time updates
- * - Recursively processes subdirectories depth-first
- * - Symlinks are intentionally skipped (logged in foreground mode)
- * - Exceptions from filesystem operations are caught and ignored
- * 
- * REVIEWER_NOTE: Symlink handling prevents traversal loops but means symlinked
- * directories are not indexed. This is a deliberate design choice.
+ * Everything appended while the previous write/fdatasync was in progress is
+ * written and synced as one batch, so the number of syncs adapts to the
+ * event rate instead of growing with it.
  */
-void add_directory_recursive(const string& dir, size_t root_index) {
-    // Add the directory itself
-    update_or_add(dir, root_index);
-    add_watch(dir);
-    
-    // Recursively add all subdirectories and files
-    try {
-        for (auto& e : directory_iterator(dir)) {
-            string p = e.path().string();
-            
-            // Skip symlinks to avoid infinite loops
-            if (e.is_symlink()) {
+void journal_writer_loop() {
+    unique_lock<mutex> lk(journal_mtx);
+    while (true) {
+        journal_cv.wait(lk, [] { return !journal_buf.empty() || journal_checkpoint_pending || journal_stop; });
+        string batch;
+        batch.swap(journal_buf);
+        uint64_t written_seq = journal_seq;  // Every assigned seq is in batch or already on disk
+        bool checkpoint = journal_checkpoint_pending;
+        uint64_t checkpoint_seq = journal_checkpoint;
+        journal_checkpoint_pending = false;
+        lk.unlock();
+        
+        if (!batch.empty()) {
+            if (!safe_write_all(journal_fd, batch.data(), batch.size()) || fdatasync(journal_fd) != 0) {
                 if (foreground) {
-                    cerr << COLOR_YELLOW << "[INFO]" << COLOR_RESET 
-                         << " Skipping symlink: " << p << "\n";
+                    cerr << COLOR_YELLOW << "Warning: Change journal write failed: " << strerror(errno) << COLOR_RESET << "\n";
                 }
-                continue;
-            }
-            
-            if (e.is_directory()) {
-                add_directory_recursive(p, root_index);
-            } else {
-                update_or_add(p, root_index);
             }
         }
-    } catch (...) {}
+        if (checkpoint) checkpoint_journal(checkpoint_seq, written_seq);
+        
+        lk.lock();
+        if (journal_stop && journal_buf.empty() && !journal_checkpoint_pending) break;
+    }
 }
 
-void build_path_index() {
-    // This function must be called in a single-threaded context (e.g., during daemon startup)
-    // or with mtx already held by the caller. It does NOT acquire the mutex itself.
-    // DO NOT call this from multiple threads without external synchronization.
-    
-    // Clear existing index
-    path_index.dir_to_entries.clear();
-    path_index.all_dirs.clear();
-    
-    for (auto& e : entries) {
-        // Extract directory path from entry path
-        size_t last_slash = e.path.rfind('/');
-        if (last_slash == string::npos) continue;  // Skip entries without directory
-        
-        string dir = e.path.substr(0, last_slash);
-        
-        // Add entry to directory index
-        path_index.dir_to_entries[dir].push_back(&e);
-        
-        // Track unique directories
-        path_index.all_dirs.insert(dir);
+void start_journal_writer() {
+    if (!journal_enabled) return;
+    journal_writer = thread(journal_writer_loop);
+}
+
+// Write out remaining records and any pending checkpoint, then stop
+void stop_journal_writer() {
+    if (journal_writer.joinable()) {
+        {
+            lock_guard<mutex> lk(journal_mtx);
+            journal_stop = true;
+        }
+        journal_cv.notify_one();
+        journal_writer.join();
     }
-    
-    if (foreground) {
-        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
-             << " Path index built: " << path_index.all_dirs.size() 
-             << " directories indexed\n";
+    if (journal_fd >= 0) {
+        close(journal_fd);
+        journal_fd = -1;
     }
+    journal_enabled = false;
 }
 
-void initial_setup(const vector<string>& roots, bool skip_indexing = false) {
-    // Initialize inotify first
-    in_fd = inotify_init1(IN_NONBLOCK);
-    if (in_fd < 0) {
-        int err = errno;
-        cerr << COLOR_RED << "ERROR: inotify_init1 failed: " << strerror(err) 
-             << " (" << err << ")" << COLOR_RESET << "\n";
-        throw runtime_error("inotify_init1 failed");
+/**
+ * Helper: ignore_write_result
+ * Purpose: Wrapper to explicitly ignore write() return value in signal handlers
+ * This is needed because newer GCC doesn't suppress warn_unused_result with (void) cast
+ */
+__attribute__((unused)) static inline void ignore_write_result(ssize_t result) {
+    (void)result;
+}
+
+// Helper function to clean up resources on socket creation/setup errors
+void cleanup_on_socket_error(int srv_fd, bool unlink_socket, const string& sock_path) {
+    // Close socket file descriptor if valid
+    if (srv_fd >= 0) {
+        close(srv_fd);
     }
     
-    // Track indexing statistics
-    auto start_time = chrono::steady_clock::now();
-    size_t total_files = 0;
-    size_t total_dirs = 0;
-    
-    // Process each root directory (already canonicalized with trailing slashes)
-    for (size_t root_idx = 0; root_idx < roots.size(); root_idx++) {
-        root_paths.push_back(roots[root_idx]);
-        
-        // Index this root only if not skipping
-        size_t initial_count = 0;
-        if (!skip_indexing) {
-            // Log start of indexing for this root
-            if (foreground) {
-                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
-                     << " Indexing " << roots[root_idx] << " ...\n";
-            }
-            
-            {
-                lock_guard<mutex> lk(mtx);
-                for (auto& e : recursive_directory_iterator(roots[root_idx], directory_options::skip_permission_denied)) {
-                    try {
-                        string p = e.path().string();
-                        struct stat st {};
-                        if (lstat(p.c_str(), &st) == 0) {
-                            bool is_dir = S_ISDIR(st.st_mode);
-                            Entry entry;
-                            entry.path = p;
-                            entry.size = is_dir ? 0LL : st.st_size;
-                            entry.mtime = st.st_mtime;
-                            entry.is_dir = is_dir;
-                            entry.root_index = root_idx;
-                            entries.push_back(entry);
-                            initial_count++;
-                            
-                            // Track file vs directory counts
-                            if (is_dir) {
-                                total_dirs++;
-                            } else {
-                                total_files++;
-                            }
-                            
-                            // Log progress every 10000 entries (in foreground mode)
-                            if (foreground && initial_count % 10000 == 0) {
-                                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
-                                     << " Indexed " << initial_count << " entries in " 
-                                     << roots[root_idx] << "...\n";
-                            }
-                        }
-                    } catch (...) {}
-                }
-            }
-            
-            // Mark entries as dirty if database is enabled
-            if (db_enabled && initial_count > 0) {
-                pending_changes += initial_count;
-                db_dirty = true;
-            }
-        }
-        
-        // Add watches for this root
-        if (foreground) {
-            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
-                 << " Setting up filesystem watches for " << roots[root_idx] << "...\n";
-        }
-        
-        int watch_count = 0;
-        function<void(const string&)> rec_add = [&](const string& d) {
-            add_watch(d);
-            watch_count++;
-            
-            // Show progress every 500 watches
-            if (foreground && watch_count % 500 == 0) {
-                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
-                     << " Added " << watch_count << " watches...\n";
-            }
-            
-            try {
-                for (auto& e : directory_iterator(d)) {
-                    // Skip symlinks to avoid infinite loops
-                    if (e.is_symlink()) {
-                        if (foreground) {
-                            cerr << COLOR_YELLOW << "[INFO]" << COLOR_RESET 
-                                 << " Skipping symlink: " << e.path() << "\n";
-                        }
-                        continue;
-                    }
-                    
-                    if (e.is_directory()) {
-                        rec_add(e.path().string());
-                    }
-                }
-            } catch (...) {}
-        };
-        rec_add(roots[root_idx]);
-        
-        if (foreground) {
-            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
-                 << " Completed: Added " << watch_count << " watches\n";
-        }
+    // Remove socket file if requested
+    if (unlink_socket) {
+        unlink(sock_path.c_str());
     }
     
-    // Log indexing complete
-    if (!skip_indexing && foreground) {
-        auto end_time = chrono::steady_clock::now();
-        auto elapsed = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
-        double elapsed_sec = elapsed.count() / 1000.0;
-        
-        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
-             << " Indexing complete: " << total_files << " files, " 
-             << total_dirs << " directories (" << fixed << setprecision(1) 
-             << elapsed_sec << "s)\n";
+    // Close database connection if open
+    if (db_enabled && db != nullptr) {
+        sqlite3_close(db);
     }
+    
+    // Close inotify file descriptor
+    close(in_fd);
+    
+    // Remove PID file
+    cleanup_pid_file();
 }
 
 /**
- * Function: process_events
- * Purpose: Main event loop for processing inotify filesystem events
- * Parameters: None
- * Returns: void (runs until 'running' flag is cleared)
- * Security:
- *   - Bounds checking on inotify event buffer parsing
- *   - Handles partial reads correctly
- *   - Validates event structure sizes before access
- *   - Protected against malformed inotify events
- * Thread-safety: Runs in dedicated thread, uses mutexes for shared data
- * 
- * REVIEWER_NOTE: This is the core filesystem monitoring loop. It must correctly
- * parse inotify events without buffer overruns. Events can be variable-length
- * due to the filename field.
- */
-void process_events() {
-    char buf[8192] __attribute__((aligned(8)));
-    auto last_cleanup = chrono::steady_clock::now();
-    
-    while (running) {
-        // Periodically clean up stale pending moves (once per second)
-        auto now = chrono::steady_clock::now();
-        if (chrono::duration_cast<chrono::seconds>(now - last_cleanup).count() >= 1) {
-            cleanup_stale_pending_moves();
-            last_cleanup = now;
+ * Function: crash_handler
+ * Purpose: Emergency cleanup on fatal signals (SIGSEGV, SIGABRT, SIGBUS)
+ * Parameters:
+ *   - sig: Signal number that triggered the crash
+ * Returns: Does not return (re-raises signal after cleanup)
+ * Security: 
+ *   - CRITICAL: Only uses async-signal-safe functions
+ *   - write() - async-signal-safe per POSIX
+ *   - close() - async-signal-safe per POSIX
+ *   - unlink() - async-signal-safe per POSIX
+ *   - signal(), raise() - async-signal-safe per POSIX
+ *   - std::atomic - NOT guaranteed async-signal-safe, but lock-free operations
+ *     typically compile to single instructions (documented risk accepted)
+ *   - NEVER calls: malloc, free, printf, C++ iostreams, sqlite3 functions
+ * Thread-safety: Called from signal context (any thread)
+ * 
+ * REVIEWER_NOTE: This function runs in signal context with severe restrictions.
+ * Only async-signal-safe functions are allowed. Any violation can cause deadlock
+ * or corruption. The use of std::atomic is a documented implementation choice
+ * that works in practice but is not guaranteed by standards.
+ */
+void crash_handler(int sig) {
+    // Use async-signal-safe functions only
+    const char* msg = nullptr;
+    size_t len = 0;
+    switch(sig) {
+        case SIGSEGV:
+            msg = "\n[CRASH] Segmentation fault - attempting emergency cleanup...\n";
+            len = sizeof("\n[CRASH] Segmentation fault - attempting emergency cleanup...\n") - 1;
+            break;
+        case SIGABRT:
+            msg = "\n[CRASH] Abort signal - attempting emergency cleanup...\n";
+            len = sizeof("\n[CRASH] Abort signal - attempting emergency cleanup...\n") - 1;
+            break;
+        case SIGBUS:
+            msg = "\n[CRASH] Bus error - attempting emergency cleanup...\n";
+            len = sizeof("\n[CRASH] Bus error - attempting emergency cleanup...\n") - 1;
+            break;
+        default:
+            msg = "\n[CRASH] Fatal signal - attempting emergency cleanup...\n";
+            len = sizeof("\n[CRASH] Fatal signal - attempting emergency cleanup...\n") - 1;
+            break;
+    }
+    if (msg != nullptr && len > 0) {
+        // SECURITY: Signal handler safety - write() is async-signal-safe
+        // Intentionally ignore return value (can't handle errors in crash handler)
+        ignore_write_result(write(STDERR_FILENO, msg, len));
+    }
+    
+    // NOTE: We use atomic operations here as best-effort cleanup.
+    // While C++ std::atomic is not guaranteed async-signal-safe by the standard,
+    // lock-free atomic operations typically compile to single instructions.
+    // In a crash scenario, we accept this for best-effort cleanup.
+    
+    // Close socket (best effort)
+    int fd = srv_fd.exchange(-1);
+    if (fd >= 0) {
+        close(fd);
+    }
+    
+    // Remove socket file (best effort)
+    if (sock_path_buf[0] != '\0') {
+        unlink(sock_path_buf);
+    }
+    
+    // Remove PID file (best effort)
+    if (pid_file_path_buf[0] != '\0') {
+        unlink(pid_file_path_buf);
+    }
+    
+    // Note: Do NOT close database here - sqlite3_close() is not async-signal-safe
+    // WAL mode will handle recovery on next startup
+    
+    // Restore default handler and re-raise for core dump
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/**
+ * Function: sig_handler
+ * Purpose: Graceful shutdown handler for SIGINT and SIGTERM
+ * Parameters:
+ *   - sig: Signal number (unused, suppressed with (void)sig)
+ * Returns: void
+ * Security:
+ *   - CRITICAL: Only uses async-signal-safe functions
+ *   - write() - async-signal-safe per POSIX (also used to signal the eventfd)
+ *   - std::atomic::exchange() - NOT guaranteed async-signal-safe, but lock-free
+ *     operations typically compile to single instructions (documented risk)
+ *   - NEVER calls: malloc, free, printf, C++ iostreams, sqlite3 functions
+ * Thread-safety: Called from signal context (any thread)
+ * 
+ * Implementation Notes:
+ * - Sets atomic flag to initiate graceful shutdown
+ * - Writes to shutdown_efd (eventfd) to wake the epoll reactor in the main thread
+ * - Main thread leaves run_event_loop() and performs full cleanup
+ * - Database writes happen in main thread, not here
+ * 
+ * REVIEWER_NOTE: This handler sets flags and signals an eventfd to wake the main thread.
+ * All complex cleanup happens in the main thread after detecting shutdown.
+ */
+void sig_handler(int sig) {
+    (void)sig;  // Unused parameter
+    
+    // NOTE: We use C++ std::atomic operations here. While not guaranteed
+    // async-signal-safe by POSIX/C++ standards, lock-free atomic operations
+    // on modern platforms typically compile to single instructions and work
+    // reliably in practice. This is a documented implementation choice.
+    
+    // Only print once using global atomic
+    if (shutdown_started.exchange(true) == false) {
+        const char msg[] = "\n[INFO] Shutdown signal received, stopping gracefully...\n";
+        // SECURITY: Signal handler safety - write() is async-signal-safe
+        // Intentionally ignore return value (can't handle errors in signal handler)
+        ignore_write_result(write(STDERR_FILENO, msg, sizeof(msg)-1));
+    }
+    
+    running = 0; 
+    
+    // Wake the reactor - write() on an eventfd is async-signal-safe
+    if (shutdown_efd >= 0) {
+        uint64_t one = 1;
+        ignore_write_result(write(shutdown_efd, &one, sizeof(one)));
+    }
+    
+    // Note: Socket and PID file cleanup happen in main() after the reactor returns
+}
+
+void daemonize() {
+    pid_t pid = fork();
+    if (pid < 0) exit(1);
+    if (pid > 0) exit(0);
+    umask(0);
+    if (setsid() < 0) exit(1);
+    close(STDIN_FILENO);
+    close(STDOUT_FILENO);
+    close(STDERR_FILENO);
+}
+
+// Link a node under its parent (keyed by basename)
+static void attach_dir_node(uint32_t id, uint32_t parent) {
+    dir_nodes[id].parent = parent;
+    if (parent != NO_NODE) {
+        dir_nodes[parent].children[string(dir_base_name(dir_nodes[id].path))] = id;
+    }
+}
+
+// Unlink a node from its parent
+static void detach_dir_node(uint32_t id) {
+    uint32_t parent = dir_nodes[id].parent;
+    if (parent != NO_NODE) {
+        auto& siblings = dir_nodes[parent].children;
+        auto it = siblings.find(string(dir_base_name(dir_nodes[id].path)));
+        if (it != siblings.end() && it->second == id) siblings.erase(it);
+    }
+    dir_nodes[id].parent = NO_NODE;
+}
+
+/**
+ * Function: release_dir_node
+ * Purpose: Forget a watched directory node and recycle its id
+ * Parameters:
+ *   - id: Node id (ignored if already free)
+ * Returns: void
+ * Thread-safety: Event loop thread only
+ * 
+ * Children still attached (their IN_IGNORED may arrive later) become orphans
+ * and are released by their own events.
+ */
+void release_dir_node(uint32_t id) {
+    DirNode& node = dir_nodes[id];
+    if (node.wd < 0) return;
+    detach_dir_node(id);
+    for (const auto& [name, child] : node.children) {
+        dir_nodes[child].parent = NO_NODE;
+    }
+    node.children.clear();
+    wd_to_node.erase(node.wd);
+    node.wd = -1;
+    node.path.clear();
+    free_dir_nodes.push_back(id);
+}
+
+/**
+ * Function: release_dir_subtree
+ * Purpose: Remove the watches of a directory and everything below it
+ * Parameters:
+ *   - id: Root node of the subtree
+ * Returns: Number of watches removed
+ * Thread-safety: Event loop thread only
+ * 
+ * Cost is O(watches in subtree); the rest of the registry is not visited.
+ */
+size_t release_dir_subtree(uint32_t id) {
+    vector<uint32_t> subtree{id};
+    for (size_t i = 0; i < subtree.size(); i++) {
+        for (const auto& [name, child] : dir_nodes[subtree[i]].children) {
+            subtree.push_back(child);
+        }
+    }
+    // Release leaves first so every node is still linked when visited
+    for (auto it = subtree.rbegin(); it != subtree.rend(); ++it) {
+        inotify_rm_watch(in_fd, dir_nodes[*it].wd);
+        release_dir_node(*it);
+    }
+    return subtree.size();
+}
+
+/**
+ * Function: move_dir_subtree
+ * Purpose: Re-parent a watched directory after a rename and fix up paths below it
+ * Parameters:
+ *   - id: Node of the renamed directory
+ *   - new_parent: Node of the directory it now lives in
+ *   - new_path: Full new path of the directory
+ * Returns: void
+ * Thread-safety: Event loop thread only
+ * 
+ * inotify watches follow the inode, so only our bookkeeping changes. Paths are
+ * rebuilt top-down from each parent, touching only the moved subtree.
+ */
+void move_dir_subtree(uint32_t id, uint32_t new_parent, const string& new_path) {
+    detach_dir_node(id);
+    dir_nodes[id].path = new_path;
+    attach_dir_node(id, new_parent);
+    size_t root_index = new_parent != NO_NODE ? dir_nodes[new_parent].root_index
+                                              : dir_nodes[id].root_index;
+    
+    vector<uint32_t> stack{id};
+    while (!stack.empty()) {
+        uint32_t cur = stack.back();
+        stack.pop_back();
+        DirNode& node = dir_nodes[cur];
+        node.root_index = root_index;
+        for (const auto& [name, child] : node.children) {
+            DirNode& c = dir_nodes[child];
+            c.path = node.path;
+            if (!c.path.ends_with('/')) c.path += '/';
+            c.path += name;
+            stack.push_back(child);
+        }
+    }
+}
+
+void update_or_add(const string& full, size_t root_index) {
+    struct stat st {};
+    if (lstat(full.c_str(), &st) != 0) return;
+
+    bool is_dir = S_ISDIR(st.st_mode);
+    int64_t sz = is_dir ? 0 : st.st_size;
+
+    content_cache_invalidate(full);
+    lock_guard<mutex> lk(mtx);
+    auto it = find_if(entries.begin(), entries.end(), [&](const Entry& e){ return e.path == full; });
+    if (it != entries.end()) {
+        // Entry already exists - update it in place
+        it->size = sz;
+        it->mtime = st.st_mtime;
+        it->is_dir = is_dir;
+        it->root_index = root_index;
+        mark_dirty_upsert(*it);
+        note_index_change(full);
+        // Path index doesn't need updating since the entry location didn't change
+    } else {
+        // New entry - add to entries and rebuild path index
+        Entry e;
+        e.path = full;
+        e.size = sz;
+        e.mtime = st.st_mtime;
+        e.is_dir = is_dir;
+        e.root_index = root_index;
+        mark_dirty_upsert(e);
+        entries.push_back(e);
+        note_index_change(full);
+        
+        // Rebuild path index to avoid dangling pointers from vector reallocation
+        // When entries vector reallocates, all stored pointers become invalid
+        path_index.dir_to_entries.clear();
+        path_index.all_dirs.clear();
+        
+        for (auto& entry : entries) {
+            size_t last_slash = entry.path.rfind('/');
+            if (last_slash != string::npos) {
+                string dir = entry.path.substr(0, last_slash);
+                path_index.dir_to_entries[dir].push_back(&entry);
+                path_index.all_dirs.insert(dir);
+            }
+        }
+    }
+    
+    // Mark DB as dirty if persistence is enabled
+    if (db_enabled) {
+        pending_changes++;
+        db_dirty = true;
+    }
+}
+
+/**
+ * Function: remove_path
+ * Purpose: Remove a file or directory from the in-memory index
+ * Parameters:
+ *   - full: Full absolute path to remove
+ *   - recursive: If true, also removes all entries under this path (for directories)
+ * Returns: void
+ * Security:
+ *   - Thread-safe: Uses mutex lock
+ *   - Rebuilds path index after removal to maintain consistency
+ *   - Updates database dirty flag if persistence is enabled
+ * Thread-safety: Thread-safe (uses mtx)
+ * 
+ * Implementation Notes:
+ * - For recursive removal, uses starts_with() to match all children
+ * - Invalidates entry pointers when vector is modified
+ * - Rebuilds entire path index for simplicity (could be optimized)
+ * - Records removed paths in the dirty set for the next database flush
+ */
+void remove_path(const string& full, bool recursive = false) {
+    content_cache_invalidate(full, recursive);
+    lock_guard<mutex> lk(mtx);
+    size_t count_before = entries.size();
+    string prefix = full + "/";
+    auto matches = [&](const Entry& e) {
+        return e.path == full || (recursive && e.path.starts_with(prefix));
+    };
+    if (db_enabled) {
+        for (const auto& e : entries) {
+            if (matches(e)) mark_dirty_delete(e.path);
+        }
+    }
+    entries.erase(remove_if(entries.begin(), entries.end(), matches), entries.end());
+    
+    // Mark DB as dirty if any entries were removed
+    size_t removed = count_before - entries.size();
+    if (db_enabled && removed > 0) {
+        pending_changes += removed;
+        db_dirty = true;
+    }
+    if (removed > 0) note_index_change(full, recursive);
+    
+    // Rebuild path index since entry pointers may have been invalidated
+    // This is simpler than trying to maintain pointers during vector modifications
+    if (removed > 0) {
+        path_index.dir_to_entries.clear();
+        path_index.all_dirs.clear();
+        
+        for (auto& e : entries) {
+            size_t last_slash = e.path.rfind('/');
+            if (last_slash != string::npos) {
+                string dir = e.path.substr(0, last_slash);
+                path_index.dir_to_entries[dir].push_back(&e);
+                path_index.all_dirs.insert(dir);
+            }
+        }
+    }
+}
+
+void handle_directory_rename(const string& old_path, const string& new_path) {
+    content_cache_invalidate(old_path, true);
+    content_cache_invalidate(new_path, true);
+    lock_guard<mutex> lk(mtx);
+    int updated = 0;
+    
+    // Update all entry paths under the renamed directory
+    for (auto& e : entries) {
+        if (e.path == old_path || e.path.starts_with(old_path + "/")) {
+            mark_dirty_delete(e.path);
+            e.path = new_path + e.path.substr(old_path.size());
+            mark_dirty_upsert(e);
+            updated++;
+        }
+    }
+    
+    // Rebuild path index since paths have changed
+    if (updated > 0) {
+        note_index_reset();
+        path_index.dir_to_entries.clear();
+        path_index.all_dirs.clear();
+        
+        for (auto& e : entries) {
+            size_t last_slash = e.path.rfind('/');
+            if (last_slash != string::npos) {
+                string dir = e.path.substr(0, last_slash);
+                path_index.dir_to_entries[dir].push_back(&e);
+                path_index.all_dirs.insert(dir);
+            }
+        }
+    }
+    
+    if (foreground) {
+        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory renamed: "
+             << COLOR_BOLD << old_path << COLOR_RESET << " -> "
+             << COLOR_BOLD << new_path << COLOR_RESET
+             << " (updated " << updated << " entries)\n";
+    }
+}
+
+void cleanup_stale_pending_moves() {
+    lock_guard<mutex> lk(pending_moves_mtx);
+    auto now = chrono::steady_clock::now();
+    for (auto it = pending_moves.begin(); it != pending_moves.end(); ) {
+        if (chrono::duration_cast<chrono::seconds>(now - it->second.time).count() > 1) {
+            // Stale move (moved out of watched tree) - treat as delete
+            const string& path = it->second.path;
+            
+            // Remove watch descriptors for the moved-out directory tree only
+            uint32_t node = it->second.node;
+            if (node != NO_NODE && dir_nodes[node].wd >= 0 && dir_nodes[node].path == path) {
+                release_dir_subtree(node);
+            }
+            
+            remove_path(path, true);  // Remove from entries
+            if (foreground) {
+                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory deleted: "
+                     << COLOR_BOLD << path << COLOR_RESET << " (moved out of tree)\n";
+            }
+            it = pending_moves.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * Function: add_watch
+ * Purpose: Register an inotify watch on a directory
+ * Parameters:
+ *   - dir: Directory path to watch
+ *   - root_index: Index of the root the directory belongs to
+ *   - parent: Node id of the parent directory (NO_NODE for a root)
+ * Returns: Node id of the watch, or NO_NODE if the watch could not be added
+ * Security:
+ *   - No validation of directory path (assumes caller validates)
+ *   - Watch descriptor stored in global wd_to_node map
+ * Thread-safety: Not thread-safe (called from single-threaded context during indexing)
+ * 
+ * inotify returns the existing descriptor when an inode is already watched,
+ * in which case the existing node is refreshed instead of allocating a new one.
+ * A directory under nested roots stays with the longest (innermost) root.
+ * 
+ * REVIEWER_NOTE: This assumes inotify_add_watch() succeeds. Failed watches are
+ * silently ignored (wd <= 0). This is acceptable as indexing continues without
+ * real-time updates for that directory.
+ */
+uint32_t add_watch(const string& dir, size_t root_index, uint32_t parent) {
+    int wd = inotify_add_watch(in_fd, dir.c_str(),
+        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (wd <= 0) return NO_NODE;
+    
+    auto it = wd_to_node.find(wd);
+    if (it != wd_to_node.end()) {
+        uint32_t id = it->second;
+        // Overlapping roots reach the same directory: keep the longest root
+        // that still contains it, whichever order the roots were walked in
+        size_t current = dir_nodes[id].root_index;
+        if (current < root_paths.size() && root_index < root_paths.size() &&
+            root_paths[current].size() > root_paths[root_index].size() &&
+            (dir + "/").starts_with(root_paths[current])) {
+            root_index = current;
+        }
+        detach_dir_node(id);
+        dir_nodes[id].path = dir;
+        dir_nodes[id].root_index = root_index;
+        attach_dir_node(id, parent);
+        return id;
+    }
+    
+    uint32_t id;
+    if (!free_dir_nodes.empty()) {
+        id = free_dir_nodes.back();
+        free_dir_nodes.pop_back();
+    } else {
+        id = static_cast<uint32_t>(dir_nodes.size());
+        dir_nodes.emplace_back();
+    }
+    DirNode& node = dir_nodes[id];
+    node.path = dir;
+    node.root_index = root_index;
+    node.wd = wd;
+    wd_to_node[wd] = id;
+    attach_dir_node(id, parent);
+    return id;
+}
+
+/**
+ * Function: add_directory_recursive
+ * Purpose: Recursively index a directory and all its subdirectories
+ * Parameters:
+ *   - dir: Directory path to index
+ *   - root_index: Index of the root directory in the roots vector
+ *   - parent: Watch node of the parent directory
+ * Returns: void
+ * Security:
+ *   - Skips symlinks to prevent infinite loops
+ *   - Exception-safe: catches all exceptions from directory iteration
+ * Thread-safety: Not thread-safe (called during initial indexing or from event thread)
+ * 
+ * Implementation Notes:
+ * - Adds inotify watch for real-time updates
+ * - Recursively processes subdirectories depth-first
+ * - Symlinks are intentionally skipped (logged in foreground mode)
+ * - Exceptions from filesystem operations are caught and ignored
+ * 
+ * REVIEWER_NOTE: Symlink handling prevents traversal loops but means symlinked
+ * directories are not indexed. This is a deliberate design choice.
+ */
+void add_directory_recursive(const string& dir, size_t root_index, uint32_t parent) {
+    // Add the directory itself
+    update_or_add(dir, root_index);
+    uint32_t node = add_watch(dir, root_index, parent);
+    
+    // Recursively add all subdirectories and files
+    try {
+        for (auto& e : directory_iterator(dir)) {
+            string p = e.path().string();
+            
+            // Skip symlinks to avoid infinite loops
+            if (e.is_symlink()) {
+                if (foreground) {
+                    cerr << COLOR_YELLOW << "[INFO]" << COLOR_RESET 
+                         << " Skipping symlink: " << p << "\n";
+                }
+                continue;
+            }
+            
+            if (e.is_directory()) {
+                add_directory_recursive(p, root_index, node);
+            } else {
+                update_or_add(p, root_index);
+            }
+        }
+    } catch (...) {}
+}
+
+void initial_setup(const vector<string>& roots, bool skip_indexing = false) {
+    // Initialize inotify first
+    in_fd = inotify_init1(IN_NONBLOCK);
+    if (in_fd < 0) {
+        int err = errno;
+        cerr << COLOR_RED << "ERROR: inotify_init1 failed: " << strerror(err) 
+             << " (" << err << ")" << COLOR_RESET << "\n";
+        throw runtime_error("inotify_init1 failed");
+    }
+    
+    // Track indexing statistics
+    auto start_time = chrono::steady_clock::now();
+    size_t total_files = 0;
+    size_t total_dirs = 0;
+    
+    // Process each root directory (already canonicalized with trailing slashes)
+    for (size_t root_idx = 0; root_idx < roots.size(); root_idx++) {
+        root_paths.push_back(roots[root_idx]);
+        
+        // Index this root only if not skipping
+        size_t initial_count = 0;
+        if (!skip_indexing) {
+            // Log start of indexing for this root
+            if (foreground) {
+                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
+                     << " Indexing " << roots[root_idx] << " ...\n";
+            }
+            
+            {
+                lock_guard<mutex> lk(mtx);
+                for (auto& e : recursive_directory_iterator(roots[root_idx], directory_options::skip_permission_denied)) {
+                    try {
+                        string p = e.path().string();
+                        struct stat st {};
+                        if (lstat(p.c_str(), &st) == 0) {
+                            bool is_dir = S_ISDIR(st.st_mode);
+                            Entry entry;
+                            entry.path = p;
+                            entry.size = is_dir ? 0LL : st.st_size;
+                            entry.mtime = st.st_mtime;
+                            entry.is_dir = is_dir;
+                            entry.root_index = root_idx;
+                            entries.push_back(entry);
+                            initial_count++;
+                            
+                            // Track file vs directory counts
+                            if (is_dir) {
+                                total_dirs++;
+                            } else {
+                                total_files++;
+                            }
+                            
+                            // Log progress every 10000 entries (in foreground mode)
+                            if (foreground && initial_count % 10000 == 0) {
+                                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
+                                     << " Indexed " << initial_count << " entries in " 
+                                     << roots[root_idx] << "...\n";
+                            }
+                        }
+                    } catch (...) {}
+                }
+            }
+            
+            // Mark entries as dirty if database is enabled
+            // A fresh index replaces the whole table once instead of tracking every path
+            if (db_enabled && initial_count > 0) {
+                lock_guard<mutex> lk(mtx);
+                db_full_rewrite = true;
+                dirty_entries.clear();
+                pending_changes += initial_count;
+                db_dirty = true;
+            }
+        }
+        
+        // Add watches for this root
+        if (foreground) {
+            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
+                 << " Setting up filesystem watches for " << roots[root_idx] << "...\n";
+        }
+        
+        int watch_count = 0;
+        function<void(const string&, uint32_t)> rec_add = [&](const string& d, uint32_t parent) {
+            uint32_t node = add_watch(d, root_idx, parent);
+            watch_count++;
+            
+            // Show progress every 500 watches
+            if (foreground && watch_count % 500 == 0) {
+                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
+                     << " Added " << watch_count << " watches...\n";
+            }
+            
+            try {
+                for (auto& e : directory_iterator(d)) {
+                    // Skip symlinks to avoid infinite loops
+                    if (e.is_symlink()) {
+                        if (foreground) {
+                            cerr << COLOR_YELLOW << "[INFO]" << COLOR_RESET 
+                                 << " Skipping symlink: " << e.path() << "\n";
+                        }
+                        continue;
+                    }
+                    
+                    if (e.is_directory()) {
+                        rec_add(e.path().string(), node);
+                    }
+                }
+            } catch (...) {}
+        };
+        rec_add(roots[root_idx], NO_NODE);
+        
+        if (foreground) {
+            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
+                 << " Completed: Added " << watch_count << " watches\n";
+        }
+    }
+    
+    // Log indexing complete
+    if (!skip_indexing && foreground) {
+        auto end_time = chrono::steady_clock::now();
+        auto elapsed = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
+        double elapsed_sec = elapsed.count() / 1000.0;
+        
+        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
+             << " Indexing complete: " << total_files << " files, " 
+             << total_dirs << " directories (" << fixed << setprecision(1) 
+             << elapsed_sec << "s)\n";
+    }
+}
+
+/**
+ * Function: set_timer
+ * Purpose: Arm or disarm a timerfd used by the event loop
+ * Parameters:
+ *   - tfd: timerfd file descriptor
+ *   - seconds: Interval in seconds (0 disarms the timer)
+ * Returns: void
+ * Thread-safety: Event loop thread only
+ */
+void set_timer(int tfd, int seconds) {
+    if (tfd < 0) return;
+    struct itimerspec its {};
+    its.it_value.tv_sec = seconds;
+    its.it_interval.tv_sec = seconds;
+    timerfd_settime(tfd, 0, &its, nullptr);
+}
+
+/**
+ * Function: process_events
+ * Purpose: Drain and handle pending inotify filesystem events
+ * Parameters: None
+ * Returns: void (returns once the non-blocking inotify fd reports EAGAIN)
+ * Security:
+ *   - Bounds checking on inotify event buffer parsing
+ *   - Handles partial reads correctly
+ *   - Validates event structure sizes before access
+ *   - Protected against malformed inotify events
+ * Thread-safety: Runs in the event loop thread, uses mutexes for shared data
+ * 
+ * Called by run_event_loop() whenever epoll reports in_fd readable, so events
+ * become visible to queries as soon as the kernel delivers them.
+ * 
+ * REVIEWER_NOTE: This is the core filesystem monitoring loop. It must correctly
+ * parse inotify events without buffer overruns. Events can be variable-length
+ * due to the filename field.
+ */
+void process_events() {
+    char buf[8192] __attribute__((aligned(8)));
+    string full;  // Reused across events to avoid per-event allocation
+    full.reserve(PATH_MAX);
+    
+    while (true) {
+        ssize_t len = read(in_fd, buf, sizeof(buf));
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            break;  // EAGAIN: queue drained
+        }
+        if (len == 0) break;
+        
+        {
+            char* ptr = buf;
+            // SECURITY: Explicit bounds checking for inotify event parsing
+            // Each event consists of: struct inotify_event + variable-length name
+            while (ptr < buf + len) {
+                // Ensure we have space for at least the event header
+                if (ptr + sizeof(struct inotify_event) > buf + len) {
+                    // Incomplete event at buffer end, should not happen with properly sized buffer
+                    break;
+                }
+                
+                auto* ev = (struct inotify_event*)ptr;
+                
+                // SECURITY: Validate that the full event (including name) fits in buffer
+                // This prevents reading beyond buffer bounds if ev->len is corrupted
+                if (ptr + sizeof(struct inotify_event) + ev->len > buf + len) {
+                    // Event extends beyond buffer, should not happen but we check anyway
+                    break;
+                }
+                
+                ptr += sizeof(struct inotify_event) + ev->len;
+
+                // O(1) lookup of the watched directory and its root
+                auto wdit = wd_to_node.find(ev->wd);
+                if (wdit == wd_to_node.end()) continue;
+                uint32_t node_id = wdit->second;
+                size_t root_idx = dir_nodes[node_id].root_index;
+
+                bool isd = ev->mask & IN_ISDIR;
+
+                if (ev->mask & IN_IGNORED) {
+                    release_dir_node(node_id);
+                    continue;
+                }
+                // Handle IN_DELETE_SELF (directory was deleted)
+                // Skip IN_MOVE_SELF as renames are handled via IN_MOVED_FROM/IN_MOVED_TO on parent
+                if (ev->mask & IN_DELETE_SELF) {
+                    string dir = dir_nodes[node_id].path;
+                    release_dir_node(node_id);
+                    int removed_count = 0;
+                    if (foreground) {
+                        lock_guard<mutex> lk(mtx);
+                        // Count entries that will be removed (for logging only)
+                        for (const auto& e : entries) {
+                            if (e.path == dir || e.path.starts_with(dir + "/")) {
+                                removed_count++;
+                            }
+                        }
+                    }
+                    remove_path(dir, true);
+                    if (foreground) {
+                        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory deleted: "
+                             << COLOR_BOLD << dir << COLOR_RESET 
+                             << " (watch removed, " << removed_count << " entries removed)\n";
+                    }
+                    continue;
+                }
+                // IN_MOVE_SELF is ignored - renames are handled at parent level
+                if (ev->mask & IN_MOVE_SELF) {
+                    // The directory was moved. If it's a rename within tree,
+                    // it's already handled by IN_MOVED_FROM/TO on parent.
+                    // If moved out of tree, the parent's IN_MOVED_FROM handles it.
+                    // The node keeps its watch; nothing to delete here.
+                    continue;
+                }
+                
+                // Every remaining event touches the index by path, so build it now
+                // in the reused buffer (no allocation once it has grown)
+                const string& dir = dir_nodes[node_id].path;
+                full.assign(dir);
+                if (!dir.ends_with('/')) full += '/';
+                if (ev->len) full += ev->name;
+                
+                // Process directory-specific events
+                if (isd) {
+                    if (ev->mask & IN_CREATE) {
+                        // New directory created - add recursively with watches
+                        add_directory_recursive(full, root_idx, node_id);
+                        if (foreground) {
+                            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory created: "
+                                 << COLOR_BOLD << full << COLOR_RESET << " (watch added)\n";
+                        }
+                    }
+                    if (ev->mask & IN_MOVED_FROM) {
+                        // Directory moved out or renamed - store in pending moves map
+                        // RACE CONDITION HANDLING: Cookie-based tracking ensures we can
+                        // match IN_MOVED_FROM with IN_MOVED_TO even if they arrive in
+                        // separate read() calls. Timeout cleanup handles moves out of tree.
+                        uint32_t moved_node = NO_NODE;
+                        auto child = dir_nodes[node_id].children.find(ev->name);
+                        if (child != dir_nodes[node_id].children.end()) moved_node = child->second;
+                        lock_guard<mutex> lk(pending_moves_mtx);
+                        pending_moves[ev->cookie] = {full, chrono::steady_clock::now(), moved_node};
+                        // Arm the cleanup timer so unmatched moves expire without polling
+                        if (pending_moves.size() == 1) set_timer(cleanup_tfd, 1);
+                        // The entry stays in pending_moves until either a matching IN_MOVED_TO
+                        // arrives in this same event-processing thread or cleanup_stale_pending_moves()
+                        // removes it after the ~1s stale timeout.
+                    }
+                    if (ev->mask & IN_MOVED_TO) {
+                        // Directory moved in or renamed - check for matching MOVED_FROM
+                        bool found_match = false;
+                        string old_path;
+                        uint32_t moved_node = NO_NODE;
+                        {
+                            lock_guard<mutex> lk(pending_moves_mtx);
+                            auto it = pending_moves.find(ev->cookie);
+                            if (it != pending_moves.end()) {
+                                old_path = move(it->second.path);
+                                moved_node = it->second.node;
+                                pending_moves.erase(it);
+                                found_match = true;
+                            }
+                        }
+                        
+                        if (found_match) {
+                            // This is a rename within our watched tree
+                            // IMPORTANT: Inotify watch descriptors automatically follow directory
+                            // renames, so we don't need to remove/re-add watches. We only need to
+                            // update our internal path mappings.
+                            if (moved_node != NO_NODE && dir_nodes[moved_node].wd >= 0 &&
+                                dir_nodes[moved_node].path == old_path) {
+                                move_dir_subtree(moved_node, node_id, full);
+                            }
+                            handle_directory_rename(old_path, full);
+                            // Inotify watch descriptors automatically follow directory renames;
+                            // no need to re-add a watch for the new path here.
+                        } else {
+                            // Moved into tree from outside - treat as new directory
+                            add_directory_recursive(full, root_idx, node_id);
+                            if (foreground) {
+                                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory created: "
+                                     << COLOR_BOLD << full << COLOR_RESET << " (moved in, watch added)\n";
+                            }
+                        }
+                    }
+                    if (ev->mask & IN_DELETE) {
+                        // Directory deleted - remove recursively
+                        remove_path(full, true);
+                        if (foreground) {
+                            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory deleted: "
+                                 << COLOR_BOLD << full << COLOR_RESET << " (watch removed)\n";
+                        }
+                    }
+                } else {
+                    // Process file events (non-directory)
+                    if (ev->mask & (IN_CREATE | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE)) {
+                        // File created, moved in, or modified - update index
+                        update_or_add(full, root_idx);
+                    }
+                    if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                        // File deleted or moved out - remove from index
+                        remove_path(full);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Regular files below this size are read with pread() into a reused
+// per-thread buffer; page-table setup and teardown for a mapping cost more
+// than the copy. Larger files are mapped.
+constexpr size_t SMALL_FILE_READ_BYTES = 128 * 1024;
+// Mappings from this size on are advised MADV_HUGEPAGE
+constexpr size_t HUGEPAGE_ADVICE_BYTES = 2 * 1024 * 1024;
+
+// Read fd into buf from offset got (buf[0, got) is already filled) until a
+// short read, growing buf to at most limit + 1 bytes. Returns the total
+// length, more than limit if the file is longer than that, or -1 on a read
+// error.
+static ssize_t pread_to_eof(int fd, string& buf, size_t got, size_t limit) {
+    while (true) {
+        if (got == buf.size()) {
+            if (got > limit) return static_cast<ssize_t>(got);
+            buf.resize(min(max(buf.size() * 2, static_cast<size_t>(4096)), limit + 1));
+        }
+        ssize_t n = pread(fd, buf.data() + got, buf.size() - got, static_cast<off_t>(got));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        got += static_cast<size_t>(n);
+        if (got < buf.size()) return static_cast<ssize_t>(got);
+    }
+}
+
+/**
+ * Class: FileContents
+ * Purpose: Read-only view of a file's contents for content search, read
+ *          with pread() or mapped with mmap() depending on its size
+ * 
+ * Security Considerations:
+ * - Uses MAP_PRIVATE to prevent modifications from affecting original file
+ * - Handles errors gracefully (returns invalid on any failure)
+ * - Empty files are handled correctly (valid but no data)
+ * - madvise() failure is non-fatal (advisory only)
+ * - Only regular files are read: devices, FIFOs and sockets (also behind
+ *   a symlink) are skipped, so /dev/zero cannot fill the heap
+ * - pread() never reads more than SMALL_FILE_READ_BYTES; a file that grew
+ *   past that since it was stat()ed is mapped instead, and a mapping is
+ *   always sized by fstat() (touching pages past EOF raises SIGBUS)
+ * 
+ * Memory Safety:
+ * - RAII: Automatically unmaps and closes on destruction
+ * - Copy-prevention: Deleted copy constructor and assignment
+ * - Small files borrow the calling thread's read buffer, so a thread may
+ *   hold only one FileContents at a time
+ * 
+ * Thread-safety: Not thread-safe (each thread creates its own instance)
+ * 
+ * Implementation Notes:
+ * - st is the caller's stat() of the file; with it a small file costs
+ *   open + pread + close. Without it the file is fstat()ed first.
+ * - A short pread() means EOF on a regular file; a full one grows the
+ *   buffer (up to the limit) and reads on, so a file that grew a little
+ *   since it was stat()ed is still read whole
+ * - Mappings get MADV_SEQUENTIAL for readahead, and MADV_HUGEPAGE from
+ *   HUGEPAGE_ADVICE_BYTES on so the kernel may back them with huge pages
+ * 
+ * REVIEWER_NOTE: This is the core of efficient content search. Large files
+ * are searched in place in the page cache; small ones, most of a source
+ * tree, are copied once into a buffer that never leaves the thread.
+ */
+struct FileContents {
+    const char* data = nullptr;
+    size_t size = 0;
+    
+    // View of bytes the caller owns (read by FilePrefetcher)
+    FileContents(const char* bytes, size_t len) : data(len ? bytes : nullptr), size(len) {}
+    
+    // st: the caller's stat() of path, or nullptr to fstat() it here
+    FileContents(const EntryPath& path, const struct stat* st) {
+        if (st && !S_ISREG(st->st_mode)) return;
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat own;
+        if (!st) {
+            if (fstat(fd, &own) != 0 || !S_ISREG(own.st_mode)) {
+                close(fd);
+                return;
+            }
+            st = &own;
+        }
+        if (static_cast<uint64_t>(st->st_size) >= SMALL_FILE_READ_BYTES || !read_all(fd, st->st_size)) map(fd);
+        close(fd);
+    }
+    
+    ~FileContents() {
+        if (mapped) munmap(const_cast<char*>(data), size);
+    }
+    
+    bool is_valid() const { return data != nullptr; }
+    
+    // Prevent copying
+    FileContents(const FileContents&) = delete;
+    FileContents& operator=(const FileContents&) = delete;
+    
+private:
+    bool mapped = false;
+    
+    static string& read_buffer() {
+        static thread_local string buffer;
+        return buffer;
+    }
+    
+    // False if the file has grown to SMALL_FILE_READ_BYTES or more
+    bool read_all(int fd, size_t expected) {
+        string& buf = read_buffer();
+        // One byte of room past the expected size makes an unchanged file
+        // end in a short read
+        size_t want = max(expected + 1, static_cast<size_t>(4096));
+        if (buf.size() < want) buf.resize(want);
+        ssize_t got = pread_to_eof(fd, buf, 0, SMALL_FILE_READ_BYTES - 1);
+        if (got < 0) return true;
+        if (static_cast<size_t>(got) >= SMALL_FILE_READ_BYTES) return false;
+        // Empty files are valid but have no content to search
+        size = static_cast<size_t>(got);
+        if (got > 0) data = buf.data();
+        return true;
+    }
+    
+    void map(int fd) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) return;
+        size_t len = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) return;
+        // madvise is advisory, failure is non-fatal
+        madvise(p, len, MADV_SEQUENTIAL);
+        if (len >= HUGEPAGE_ADVICE_BYTES) madvise(p, len, MADV_HUGEPAGE);
+        data = static_cast<const char*>(p);
+        size = len;
+        mapped = true;
+    }
+};
+
+#ifdef HAVE_IO_URING
+/**
+ * Class: IoUring
+ * Purpose: Minimal io_uring instance on raw syscalls, for queueing file
+ *          stats, opens and reads (liburing is not a dependency)
+ * 
+ * Implementation Notes:
+ * - The SQ index array is filled once with the identity, so the SQE for
+ *   tail t is always sqes[t & mask]
+ * - Tails we publish are stored with release semantics and the kernel's
+ *   are loaded with acquire semantics; each head is only written by its
+ *   consumer
+ * - Callers keep at most sq_entries requests in flight, so get_sqe() never
+ *   finds the ring full and the (twice as large) CQ never overflows
+ * 
+ * Thread-safety: Not thread-safe (one instance per worker thread)
+ */
+class IoUring {
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    
+    ~IoUring() {
+        if (sqes) munmap(sqes, sqes_bytes);
+        if (cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_bytes);
+        if (sq_ring) munmap(sq_ring, sq_bytes);
+        if (ring_fd >= 0) close(ring_fd);
+    }
+    
+    // Set up a ring for 'entries' requests in flight. False, with the
+    // reason in 'why', if the kernel has no io_uring (ENOSYS), forbids it
+    // (EPERM: seccomp, kernel.io_uring_disabled) or lacks STATX/OPENAT/READ.
+    bool init(unsigned entries, string& why) {
+        io_uring_params p{};
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (fd < 0) {
+            why = string("io_uring_setup: ") + strerror(errno);
+            return false;
+        }
+        ring_fd = fd;
+        sq_bytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_bytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) sq_bytes = cq_bytes = max(sq_bytes, cq_bytes);
+        sq_ring = map_region(sq_bytes, IORING_OFF_SQ_RING);
+        cq_ring = single_mmap ? sq_ring : map_region(cq_bytes, IORING_OFF_CQ_RING);
+        sqes_bytes = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(map_region(sqes_bytes, IORING_OFF_SQES));
+        if (!sq_ring || !cq_ring || !sqes) {
+            why = string("mmap: ") + strerror(errno);
+            return false;
+        }
+        
+        char* sq = static_cast<char*>(sq_ring);
+        char* cq = static_cast<char*>(cq_ring);
+        sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_entries = p.sq_entries;
+        unsigned* sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        for (unsigned i = 0; i < sq_entries; i++) sq_array[i] = i;
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        local_tail = submitted = *sq_tail;
+        
+        // STATX, OPENAT and READ arrived in 5.6, together with the probe itself
+        vector<char> probe_buf(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(probe_buf.data());
+        if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+            why = string("opcode probe: ") + strerror(errno);
+            return false;
+        }
+        for (int op : {IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                why = "STATX/OPENAT/READ not supported";
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Next free SQE, zeroed (the caller fills it in); nullptr if full
+    io_uring_sqe* get_sqe() {
+        if (local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) return nullptr;
+        io_uring_sqe* sqe = &sqes[local_tail & sq_mask];
+        local_tail++;
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+    
+    // Submit the SQEs filled since the last call and wait until at least
+    // wait_nr completions are available (0 = don't wait). False on an
+    // unexpected error.
+    bool submit(unsigned wait_nr) {
+        __atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+        while (true) {
+            unsigned pending = local_tail - submitted;
+            if (pending == 0 && wait_nr == 0) return true;
+            long ret = syscall(__NR_io_uring_enter, ring_fd, pending, wait_nr,
+                               wait_nr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (ret >= 0) {
+                submitted += static_cast<unsigned>(ret);
+                return true;
+            }
+            if (errno != EINTR) return false;
+        }
+    }
+    
+    // Hand each available completion to handle(cqe), oldest first
+    template <typename F>
+    void reap(F&& handle) {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) handle(cqes[head & cq_mask]);
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+    
+private:
+    int ring_fd = -1;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    size_t sq_bytes = 0, cq_bytes = 0, sqes_bytes = 0;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned sq_mask = 0, cq_mask = 0, sq_entries = 0;
+    unsigned local_tail = 0;  // SQEs handed out by get_sqe()
+    unsigned submitted = 0;   // SQEs the kernel has consumed
+    
+    void* map_region(size_t len, off_t offset) {
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+};
+#endif
+
+/**
+ * Function: send_results_batched
+ * Purpose: Send search results to client using batched writev() for efficiency
+ * Parameters:
+ *   - fd: Client socket file descriptor
+ *   - results: Vector of result strings to send
+ * Returns: void
+ * Security:
+ *   - Handles EINTR correctly in writev() loop
+ *   - Handles partial writes correctly
+ *   - No buffer overflow risk (sends only complete strings)
+ * Thread-safety: Thread-safe (each client has unique fd)
+ * 
+ * Performance Notes:
+ * - Uses writev() to batch multiple strings into fewer syscalls
+ * - Reduces context switches compared to individual write() calls
+ * - Batches up to 1024 iovecs at a time (typical IOV_MAX on Linux)
+ * - Handles partial writes by adjusting iovec pointers
+ * 
+ * REVIEWER_NOTE: This function implements the gather I/O pattern for efficiency.
+ * The partial write handling is complex but correct.
+ */
+void send_results_batched(int fd, const vector<string>& results) {
+    if (results.empty()) return;
+    
+    const size_t MAX_IOV = 1024;  // Typical IOV_MAX on Linux
+    vector<struct iovec> iov;
+    iov.reserve(MAX_IOV);
+    
+    for (size_t i = 0; i < results.size(); i++) {
+        struct iovec vec;
+        vec.iov_base = const_cast<char*>(results[i].c_str());
+        vec.iov_len = results[i].size();
+        iov.push_back(vec);
+        
+        // Flush batch when full or at end
+        if (iov.size() >= MAX_IOV || i == results.size() - 1) {
+            size_t offset = 0;
+            while (offset < iov.size()) {
+                ssize_t n = writev(fd, iov.data() + offset, iov.size() - offset);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    // Log error to stderr (client socket might be closed)
+                    // Silently return - client disconnect is expected
+                    return;
+                }
+                
+                // Advance offset by number of complete iovecs written
+                size_t bytes_written = n;
+                while (offset < iov.size() && bytes_written >= iov[offset].iov_len) {
+                    bytes_written -= iov[offset].iov_len;
+                    offset++;
+                }
+                
+                // Handle partial iovec write
+                if (bytes_written > 0 && offset < iov.size()) {
+                    iov[offset].iov_base = (char*)iov[offset].iov_base + bytes_written;
+                    iov[offset].iov_len -= bytes_written;
+                }
+            }
+            iov.clear();
+        }
+    }
+}
+
+/*
+ * SIMD text scanning
+ * 
+ * Content search looks for a literal in the whole mapped buffer rather than
+ * line by line, and only locates line boundaries around hits. LiteralMatcher
+ * compares two probe bytes of the needle - the rarest ones by a static
+ * frequency table - against 16/32 positions per step (SSE2/AVX2) and
+ * verifies candidates. For -i, a letter probe is compared after OR-ing 0x20
+ * into the text, which folds ASCII case (non-letters that collide are
+ * rejected by verification), so case-insensitive search runs the same
+ * kernel on the mapping with no per-line copies. count_newlines() turns
+ * byte compares into bitmasks and popcounts them. The AVX2 variants are
+ * chosen at runtime; other architectures use a scalar loop.
+ * 
+ * Case folding is ASCII only, like strcasestr() in the daemon's C locale.
+ */
+static const unsigned char* ascii_lower_table() {
+    static const auto table = [] {
+        array<unsigned char, 256> t {};
+        for (int c = 0; c < 256; c++) t[c] = static_cast<unsigned char>(c >= 'A' && c <= 'Z' ? c + 32 : c);
+        return t;
+    }();
+    return table.data();
+}
+
+// Rough frequency of a byte in source code and text (higher = more common)
+static int byte_frequency(unsigned char c) {
+    static const char* common = " etaoinsrhldcumfpgwybvkxjqz";  // Most to least frequent
+    if (c >= 'A' && c <= 'Z') return byte_frequency(static_cast<unsigned char>(c + 32)) / 4;
+    if (const char* p = c ? strchr(common, c) : nullptr) return 255 - static_cast<int>(p - common) * 8;
+    if (c >= '0' && c <= '9') return 100;
+    if (c && strchr("_()=;,.-/*\"'{}:<>#[]", c)) return 90;
+    return 10;
+}
+
+struct LiteralMatcher {
+    string needle;      // Lowercased when icase
+    bool icase = false;
+    size_t probe1 = 0;  // Offsets of the two probe bytes, probe1 <= probe2
+    size_t probe2 = 0;
+    
+    LiteralMatcher() = default;
+    LiteralMatcher(const string& pattern, bool ignore_case) : needle(pattern), icase(ignore_case) {
+        if (icase) {
+            const unsigned char* lower = ascii_lower_table();
+            for (char& c : needle) c = static_cast<char>(lower[static_cast<unsigned char>(c)]);
+        }
+        auto score = [&](size_t i) {
+            unsigned char c = static_cast<unsigned char>(needle[i]);
+            bool letter = c >= 'a' && c <= 'z';
+            return (icase && letter) ? byte_frequency(c) + byte_frequency(static_cast<unsigned char>(c - 32))
+                                     : byte_frequency(c);
+        };
+        for (size_t i = 1; i < needle.size(); i++) {
+            if (score(i) < score(probe1)) probe1 = i;
+        }
+        probe2 = probe1;
+        for (size_t i = 0; i < needle.size(); i++) {
+            if (i != probe1 && (probe2 == probe1 || score(i) < score(probe2))) probe2 = i;
+        }
+        if (probe2 < probe1) swap(probe1, probe2);
+    }
+    
+    bool folds(size_t probe) const {
+        unsigned char c = static_cast<unsigned char>(needle[probe]);
+        return icase && c >= 'a' && c <= 'z';
+    }
+    
+    bool verify(const char* p) const {
+        if (!icase) return memcmp(p, needle.data(), needle.size()) == 0;
+        const unsigned char* lower = ascii_lower_table();
+        for (size_t i = 0; i < needle.size(); i++) {
+            if (lower[static_cast<unsigned char>(p[i])] != static_cast<unsigned char>(needle[i])) return false;
+        }
+        return true;
+    }
+    
+    // Positions [from, n - m] not covered by the vector loop
+    const char* find_scalar(const char* hay, size_t from, size_t n) const {
+        size_t m = needle.size();
+        if (!icase) {
+            const void* r = memmem(hay + from, n - from, needle.data(), m);
+            return static_cast<const char*>(r);
+        }
+        const unsigned char* lower = ascii_lower_table();
+        unsigned char p1 = static_cast<unsigned char>(needle[probe1]);
+        for (size_t i = from; i + m <= n; i++) {
+            if (lower[static_cast<unsigned char>(hay[i + probe1])] == p1 && verify(hay + i)) return hay + i;
+        }
+        return nullptr;
+    }
+    
+    const char* find(const char* hay, size_t n) const;
+};
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static const char* find_literal_avx2(const LiteralMatcher& lm, const char* hay, size_t n) {
+    size_t m = lm.needle.size();
+    const __m256i b1 = _mm256_set1_epi8(lm.needle[lm.probe1]);
+    const __m256i b2 = _mm256_set1_epi8(lm.needle[lm.probe2]);
+    const __m256i f1 = _mm256_set1_epi8(lm.folds(lm.probe1) ? 0x20 : 0);
+    const __m256i f2 = _mm256_set1_epi8(lm.folds(lm.probe2) ? 0x20 : 0);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i + lm.probe1));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i + lm.probe2));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_or_si256(a, f1), b1),
+                             _mm256_cmpeq_epi8(_mm256_or_si256(b, f2), b2))));
+        while (mask) {
+            const char* p = hay + i + __builtin_ctz(mask);
+            if (lm.verify(p)) return p;
+            mask &= mask - 1;
+        }
+    }
+    return lm.find_scalar(hay, i, n);
+}
+
+static const char* find_literal_sse2(const LiteralMatcher& lm, const char* hay, size_t n) {
+    size_t m = lm.needle.size();
+    const __m128i b1 = _mm_set1_epi8(lm.needle[lm.probe1]);
+    const __m128i b2 = _mm_set1_epi8(lm.needle[lm.probe2]);
+    const __m128i f1 = _mm_set1_epi8(lm.folds(lm.probe1) ? 0x20 : 0);
+    const __m128i f2 = _mm_set1_epi8(lm.folds(lm.probe2) ? 0x20 : 0);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + lm.probe1));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + lm.probe2));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(a, f1), b1),
+                          _mm_cmpeq_epi8(_mm_or_si128(b, f2), b2))));
+        while (mask) {
+            const char* p = hay + i + __builtin_ctz(mask);
+            if (lm.verify(p)) return p;
+            mask &= mask - 1;
+        }
+    }
+    return lm.find_scalar(hay, i, n);
+}
+
+__attribute__((target("avx2")))
+static size_t count_newlines_avx2(const char* p, size_t n) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t count = 0, i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        count += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl))));
+    }
+    for (; i < n; i++) count += p[i] == '\n';
+    return count;
+}
+
+static size_t count_newlines_sse2(const char* p, size_t n) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t count = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        count += __builtin_popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl))));
+    }
+    for (; i < n; i++) count += p[i] == '\n';
+    return count;
+}
+
+static const bool cpu_has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+// First occurrence of the needle in hay[0..n), or nullptr
+const char* LiteralMatcher::find(const char* hay, size_t n) const {
+    size_t m = needle.size();
+    if (m == 0 || m > n) return m == 0 ? hay : nullptr;
+    if (m == 1 && !folds(0)) return static_cast<const char*>(memchr(hay, needle[0], n));
+#if defined(__x86_64__)
+    return cpu_has_avx2 ? find_literal_avx2(*this, hay, n) : find_literal_sse2(*this, hay, n);
+#else
+    return find_scalar(hay, 0, n);
+#endif
+}
+
+// Number of '\n' bytes in p[0..n)
+static size_t count_newlines(const char* p, size_t n) {
+#if defined(__x86_64__)
+    return cpu_has_avx2 ? count_newlines_avx2(p, n) : count_newlines_sse2(p, n);
+#else
+    size_t count = 0;
+    for (const char* q = p; (q = static_cast<const char*>(memchr(q, '\n', p + n - q))); q++) count++;
+    return count;
+#endif
+}
+
+/**
+ * Struct: RegexPrefilter
+ * Purpose: Literals of which every line matching a regex contains at least one
+ * 
+ * Built from RE2's prefilter (FilteredRE2), whose atoms form an AND/OR tree
+ * of lowercased strings a match must contain. The tree is reduced to one
+ * minimal "any of" set: all atoms are first assumed absent (which must fail
+ * the filter), then atoms are dropped from the set while the filter still
+ * fails without them. AND(a, b) leaves one of a or b, OR(a, b) keeps both.
+ * Longer atoms are kept in preference to shorter, more common ones.
+ * 
+ * Atoms are lowercased even for case-sensitive patterns, so they are matched
+ * with ASCII case folding, which only admits extra candidates. Patterns whose
+ * atoms contain non-ASCII bytes (Unicode case folding) get no prefilter.
+ */
+struct RegexPrefilter {
+    vector<LiteralMatcher> any_of;  // Empty: every line is a candidate
+    
+    bool active() const { return !any_of.empty(); }
+    
+    // Whether p[0..n) contains one of the literals
+    bool admits(const char* p, size_t n) const {
+        for (const LiteralMatcher& lm : any_of) {
+            if (lm.find(p, n)) return true;
+        }
+        return false;
+    }
+};
+
+// Atoms shorter than this are dropped by RE2 (treated as always present)
+constexpr int PREFILTER_MIN_ATOM_LEN = 3;
+
+static RegexPrefilter build_regex_prefilter(const string& pattern, const RE2::Options& opts) {
+    RegexPrefilter pf;
+    re2::FilteredRE2 filter(PREFILTER_MIN_ATOM_LEN);
+    int id;
+    if (filter.Add(pattern, opts, &id) != RE2::NoError) return pf;
+    vector<string> atoms;
+    filter.Compile(&atoms);
+    if (atoms.empty()) return pf;
+    for (const string& atom : atoms) {
+        for (char c : atom) {
+            if (static_cast<unsigned char>(c) >= 0x80) return pf;
+        }
+    }
+    
+    // Whether the regex passes the filter with the atoms in `absent` missing
+    vector<bool> absent(atoms.size(), true);
+    auto passes = [&]() {
+        vector<int> present, potential;
+        for (size_t i = 0; i < atoms.size(); i++) {
+            if (!absent[i]) present.push_back(static_cast<int>(i));
+        }
+        filter.AllPotentials(present, &potential);
+        return !potential.empty();
+    };
+    if (passes()) return pf;  // Unfiltered: no atom is required
+    
+    vector<size_t> order(atoms.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return atoms[a].size() < atoms[b].size(); });
+    for (size_t i : order) {
+        absent[i] = false;
+        if (passes()) absent[i] = true;  // Still needed
+    }
+    for (size_t i = 0; i < atoms.size(); i++) {
+        if (absent[i]) pf.any_of.emplace_back(atoms[i], true);
+    }
+    return pf;
+}
+
+/**
+ * Struct: AhoCorasick
+ * Purpose: Dense Aho-Corasick automaton finding many literals in one pass
+ * 
+ * Transitions are fully resolved (failure links folded in), so scanning is
+ * one table load per byte. Columns are byte classes: every byte occurring in
+ * a pattern gets its own class and all other bytes share class 0, which
+ * keeps a few hundred patterns within a few MB. With icase, upper-case
+ * letters map to the class of their lower-case form (ASCII only, like
+ * LiteralMatcher). Entries are row offsets with MATCH set when the target
+ * state ends a pattern, so the scan loop has a single test per byte.
+ */
+struct AhoCorasick {
+    static constexpr uint32_t MATCH = 0x80000000u;
+    
+    array<uint16_t, 256> byte_class {};
+    uint32_t classes = 1;
+    vector<uint32_t> delta;      // Row offset of state * classes + class -> next row (| MATCH)
+    vector<uint32_t> out_begin;  // Patterns ending in state s: out_ids[out_begin[s] .. out_begin[s + 1])
+    vector<int> out_ids;
+    
+    bool empty() const { return delta.empty(); }
+    
+    // Returns false if the automaton would need more than max_cells transitions
+    bool build(const vector<string>& patterns, bool icase, size_t max_cells) {
+        const unsigned char* lower = ascii_lower_table();
+        auto fold = [&](char c) { return icase ? lower[static_cast<unsigned char>(c)] : static_cast<unsigned char>(c); };
+        size_t states = 1;
+        for (const string& pat : patterns) {
+            for (char c : pat) {
+                if (!byte_class[fold(c)]) byte_class[fold(c)] = static_cast<uint16_t>(classes++);
+            }
+            states += pat.size();
         }
-        
-        // Check if we should flush to database
-        maybe_flush_to_db();
-        
-        // Use poll with timeout for better signal responsiveness
-        struct pollfd pfd = {in_fd, POLLIN, 0};
-        int ret = poll(&pfd, 1, 100);  // 100ms timeout
-        
-        if (ret < 0) {
-            if (errno == EINTR) continue;  // Interrupted by signal, check running flag
-            break;
+        if (icase) {
+            for (int c = 'A'; c <= 'Z'; c++) byte_class[c] = byte_class[c + 32];
         }
+        if (states * classes > max_cells) return false;
         
-        if (ret == 0) continue;  // Timeout, check running flag
-        
-        if (!(pfd.revents & POLLIN)) continue;
-        
-        ssize_t len = read(in_fd, buf, sizeof(buf));
-        if (len > 0) {
-            char* ptr = buf;
-            // SECURITY: Explicit bounds checking for inotify event parsing
-            // Each event consists of: struct inotify_event + variable-length name
-            while (ptr < buf + len) {
-                // Ensure we have space for at least the event header
-                if (ptr + sizeof(struct inotify_event) > buf + len) {
-                    // Incomplete event at buffer end, should not happen with properly sized buffer
-                    break;
+        // Trie; 0 means "no edge" since the root is nobody's child
+        delta.assign(classes, 0);
+        vector<vector<int>> outs(1);
+        for (size_t id = 0; id < patterns.size(); id++) {
+            uint32_t s = 0;
+            for (char c : patterns[id]) {
+                size_t cell = s * classes + byte_class[fold(c)];
+                if (!delta[cell]) {
+                    delta[cell] = static_cast<uint32_t>(outs.size());
+                    outs.emplace_back();
+                    delta.resize(delta.size() + classes, 0);
                 }
-                
-                auto* ev = (struct inotify_event*)ptr;
-                
-                // SECURITY: Validate that the full event (including name) fits in buffer
-                // This prevents reading beyond buffer bounds if ev->len is corrupted
-                if (ptr + sizeof(struct inotify_event) + ev->len > buf + len) {
-                    // Event extends beyond buffer, should not happen but we check anyway
-                    break;
+                s = delta[cell];
+            }
+            outs[s].push_back(static_cast<int>(id));
+        }
+        
+        // Breadth-first: resolve missing edges through failure links and
+        // inherit the outputs of the failure state (the root's empty-pattern
+        // outputs are reported once per scan instead)
+        vector<uint32_t> fail(outs.size(), 0), order;
+        for (uint32_t c = 0; c < classes; c++) {
+            if (delta[c]) order.push_back(delta[c]);
+        }
+        for (size_t head = 0; head < order.size(); head++) {
+            uint32_t s = order[head];
+            if (fail[s]) outs[s].insert(outs[s].end(), outs[fail[s]].begin(), outs[fail[s]].end());
+            for (uint32_t c = 0; c < classes; c++) {
+                uint32_t& t = delta[s * classes + c];
+                uint32_t via_fail = delta[fail[s] * classes + c];
+                if (t) {
+                    fail[t] = via_fail;
+                    order.push_back(t);
+                } else {
+                    t = via_fail;
                 }
-                
-                ptr += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        
+        out_begin.assign(1, 0);
+        for (const vector<int>& o : outs) {
+            out_ids.insert(out_ids.end(), o.begin(), o.end());
+            out_begin.push_back(static_cast<uint32_t>(out_ids.size()));
+        }
+        for (uint32_t& t : delta) t = t * classes | (t && !outs[t].empty() ? MATCH : 0);
+        return true;
+    }
+    
+    // Last byte of the first pattern occurrence in p[0..n), or nullptr
+    const char* find_end(const char* p, size_t n) const {
+        uint32_t row = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint32_t t = delta[row + byte_class[static_cast<unsigned char>(p[i])]];
+            if (t & MATCH) return p + i;
+            row = t;
+        }
+        return nullptr;
+    }
+    
+    // Append the ids of all patterns occurring in p[0..n) (unsorted, may repeat)
+    void match_all(const char* p, size_t n, vector<int>& ids) const {
+        ids.insert(ids.end(), out_ids.begin(), out_ids.begin() + out_begin[1]);
+        uint32_t row = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint32_t t = delta[row + byte_class[static_cast<unsigned char>(p[i])]];
+            if (t & MATCH) {
+                t &= ~MATCH;
+                uint32_t s = t / classes;
+                ids.insert(ids.end(), out_ids.begin() + out_begin[s], out_ids.begin() + out_begin[s + 1]);
+            }
+            row = t;
+        }
+    }
+};
 
-                auto wdit = wd_to_dir.find(ev->wd);
-                if (wdit == wd_to_dir.end()) continue;
-                string dir = wdit->second;
-                string name = ev->len ? ev->name : "";
-                string full = dir;
-                if (!dir.ends_with("/")) full += "/";
-                full += name;
+// Transition table limit for a pattern list (64MB of uint32_t)
+constexpr size_t MAX_AUTOMATON_CELLS = 16 * 1024 * 1024;
 
-                bool isd = ev->mask & IN_ISDIR;
+/**
+ * Struct: MultiPattern
+ * Purpose: Pattern list of a multi-pattern search (-e/-f), matched in one pass
+ * 
+ * Literals are compiled into one AhoCorasick automaton. Regexes go through
+ * FilteredRE2: their required atoms are compiled into the automaton instead,
+ * and a line's atoms select the regexes worth running on it. Regexes that
+ * need no atom (or every regex, if an atom is non-ASCII and so beyond the
+ * automaton's case folding) are matched with one RE2::Set per line.
+ */
+struct MultiPattern {
+    vector<string> patterns;
+    bool is_regex = false;
+    AhoCorasick automaton;                  // Literals, or the regexes' atoms
+    bool has_empty = false;                 // An empty literal matches every line
+    unique_ptr<re2::FilteredRE2> filtered;  // All regexes, when atoms are usable
+    vector<int> unfiltered_ids;             // Regexes that can match without an atom
+    unique_ptr<RE2::Set> unfiltered;
+    
+    // Whether only lines containing an automaton hit can match
+    bool skips_lines() const {
+        return !automaton.empty() && (is_regex ? unfiltered_ids.empty() : !has_empty);
+    }
+    
+    // Sorted ids of the patterns matching one line (atoms is scratch space)
+    void match_line(const char* p, size_t n, vector<int>& ids, vector<int>& atoms) const {
+        ids.clear();
+        if (!is_regex) {
+            automaton.match_all(p, n, ids);
+        } else {
+            atoms.clear();
+            if (!automaton.empty()) automaton.match_all(p, n, atoms);
+            re2::StringPiece line(p, n);
+            if (!atoms.empty()) {
+                sort(atoms.begin(), atoms.end());
+                atoms.erase(unique(atoms.begin(), atoms.end()), atoms.end());
+                filtered->AllMatches(line, atoms, &ids);
+            } else if (unfiltered && unfiltered->Match(line, &ids)) {
+                for (int& id : ids) id = unfiltered_ids[id];
+            }
+        }
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    }
+};
 
-                if (ev->mask & IN_IGNORED) {
-                    wd_to_dir.erase(ev->wd);
-                    continue;
-                }
-                // Handle IN_DELETE_SELF (directory was deleted)
-                // Skip IN_MOVE_SELF as renames are handled via IN_MOVED_FROM/IN_MOVED_TO on parent
-                if (ev->mask & IN_DELETE_SELF) {
-                    wd_to_dir.erase(ev->wd);
-                    int removed_count = 0;
-                    if (foreground) {
-                        lock_guard<mutex> lk(mtx);
-                        // Count entries that will be removed (for logging only)
-                        for (const auto& e : entries) {
-                            if (e.path == dir || e.path.starts_with(dir + "/")) {
-                                removed_count++;
-                            }
-                        }
-                    }
-                    remove_path(dir, true);
-                    if (foreground) {
-                        cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory deleted: "
-                             << COLOR_BOLD << dir << COLOR_RESET 
-                             << " (watch removed, " << removed_count << " entries removed)\n";
-                    }
-                    continue;
+/**
+ * Function: compile_multi_pattern
+ * Purpose: Build the matchers of a pattern list
+ * Parameters:
+ *   - mp: Pattern list (patterns and is_regex set by the caller)
+ *   - case_ins: Case-insensitive matching
+ * Returns: Empty string on success, otherwise the error line for the client
+ */
+static string compile_multi_pattern(MultiPattern& mp, bool case_ins) {
+    if (!mp.is_regex) {
+        for (const string& pat : mp.patterns) mp.has_empty |= pat.empty();
+        if (!mp.automaton.build(mp.patterns, case_ins, MAX_AUTOMATON_CELLS)) return "Pattern list too large\n";
+        return "";
+    }
+    
+    RE2::Options opts;
+    opts.set_case_sensitive(!case_ins);
+    mp.filtered = make_unique<re2::FilteredRE2>(PREFILTER_MIN_ATOM_LEN);
+    for (size_t i = 0; i < mp.patterns.size(); i++) {
+        int id;
+        if (mp.filtered->Add(mp.patterns[i], opts, &id) != RE2::NoError) {
+            return "Invalid regex pattern " + to_string(i + 1) + "\n";
+        }
+    }
+    vector<string> atoms;
+    mp.filtered->Compile(&atoms);
+    bool ascii = all_of(atoms.begin(), atoms.end(), [](const string& a) {
+        return all_of(a.begin(), a.end(), [](char c) { return static_cast<unsigned char>(c) < 0x80; });
+    });
+    if (ascii && !atoms.empty()) {
+        if (!mp.automaton.build(atoms, true, MAX_AUTOMATON_CELLS)) return "Pattern list too large\n";
+        mp.filtered->AllPotentials({}, &mp.unfiltered_ids);
+    } else {
+        mp.filtered.reset();
+        for (size_t i = 0; i < mp.patterns.size(); i++) mp.unfiltered_ids.push_back(static_cast<int>(i));
+    }
+    
+    if (!mp.unfiltered_ids.empty()) {
+        opts.set_max_mem(64 << 20);
+        mp.unfiltered = make_unique<RE2::Set>(opts, RE2::UNANCHORED);
+        for (int id : mp.unfiltered_ids) {
+            if (mp.unfiltered->Add(mp.patterns[id], nullptr) < 0) return "Invalid regex pattern " + to_string(id + 1) + "\n";
+        }
+        if (!mp.unfiltered->Compile()) return "Pattern list too large\n";
+    }
+    return "";
+}
+
+/**
+ * Function: glob_to_regex
+ * Purpose: Translate a content glob into an RE2 pattern for a whole line
+ * Parameters:
+ *   - glob: fnmatch() pattern (flags 0 or FNM_CASEFOLD, C locale)
+ *   - case_ins: FNM_CASEFOLD semantics are wanted
+ *   - out: Receives the unanchored pattern body, to be anchored by the
+ *          caller and compiled with Latin-1 encoding and
+ *          case_sensitive = !case_ins
+ * Returns: true if the translation matches exactly what fnmatch() would;
+ *          false for constructs that are left to fnmatch() (equivalence
+ *          classes, collating symbols, ranges ending in '[', a trailing
+ *          backslash, and with case folding non-ASCII bytes, [:upper:],
+ *          [:lower:] or ranges that mix letters with other bytes)
+ *
+ * Every pattern byte is emitted as \xHH, so nothing in the glob is ever
+ * interpreted as regex syntax. Like fnmatch(), '[' without a closing ']'
+ * is literal, "!" or "^" negates a bracket, ']' first in a bracket is
+ * literal and '\' escapes the next character, also inside brackets.
+ */
+static bool glob_to_regex(const string& glob, bool case_ins, string& out) {
+    auto hex = [](unsigned char c) {
+        static const char* digits = "0123456789abcdef";
+        return string("\\x") + digits[c >> 4] + digits[c & 15];
+    };
+    auto letter = [](unsigned char c) { return isalpha(c) != 0; };
+    out.clear();
+    size_t i = 0, n = glob.size();
+    while (i < n) {
+        unsigned char c = static_cast<unsigned char>(glob[i]);
+        if (case_ins && c >= 0x80) return false;
+        if (c == '*') {
+            out += ".*";
+            i++;
+        } else if (c == '?') {
+            out += '.';
+            i++;
+        } else if (c == '\\') {
+            if (i + 1 >= n) return false;  // fnmatch() never matches a trailing '\'
+            unsigned char e = static_cast<unsigned char>(glob[i + 1]);
+            if (case_ins && e >= 0x80) return false;
+            out += hex(e);
+            i += 2;
+        } else if (c == '[') {
+            // Find the closing ']' first; without one '[' is literal
+            size_t j = i + 1;
+            if (j < n && (glob[j] == '!' || glob[j] == '^')) j++;
+            if (j < n && glob[j] == ']') j++;
+            while (j < n && glob[j] != ']') {
+                if (glob[j] == '\\' && j + 1 < n) {
+                    j += 2;
+                } else if (glob[j] == '-' && j + 1 < n && glob[j + 1] == '[') {
+                    return false;  // fnmatch() has its own rules for "a-[:class:]"
+                } else if (glob[j] == '[' && j + 1 < n && (glob[j + 1] == ':' || glob[j + 1] == '=' || glob[j + 1] == '.')) {
+                    size_t close = glob.find(string(1, glob[j + 1]) + "]", j + 2);
+                    j = close == string::npos ? j + 1 : close + 2;
+                } else {
+                    j++;
                 }
-                // IN_MOVE_SELF is ignored - renames are handled at parent level
-                if (ev->mask & IN_MOVE_SELF) {
-                    // The directory was moved. If it's a rename within tree,
-                    // it's already handled by IN_MOVED_FROM/TO on parent.
-                    // If moved out of tree, the parent's IN_MOVED_FROM handles it.
-                    // Just update the wd_to_dir if needed, but don't delete.
+            }
+            if (j >= n) {
+                out += hex(c);
+                i++;
+                continue;
+            }
+
+            size_t k = i + 1;
+            string cls = "[";
+            if (glob[k] == '!' || glob[k] == '^') {
+                cls += '^';
+                k++;
+            }
+            bool first = true;
+            while (k < j) {
+                if (glob[k] == ']' && !first) break;
+                first = false;
+                if (glob[k] == '[' && k + 1 < j && glob[k + 1] == ':') {
+                    size_t close = glob.find(":]", k + 2);
+                    if (close == string::npos || close >= j) return false;
+                    string name = glob.substr(k + 2, close - k - 2);
+                    static const char* known[] = {"alnum", "alpha", "blank", "cntrl", "digit", "graph",
+                                                   "lower", "print", "punct", "space", "upper", "xdigit"};
+                    if (find(begin(known), end(known), name) == end(known)) return false;
+                    if (case_ins && (name == "upper" || name == "lower")) return false;
+                    cls += "[:" + name + ":]";
+                    k = close + 2;
                     continue;
                 }
-                
-                // Process directory-specific events
-                if (isd) {
-                    if (ev->mask & IN_CREATE) {
-                        // New directory created - add recursively with watches
-                        size_t root_idx = find_root_index(full);
-                        add_directory_recursive(full, root_idx);
-                        if (foreground) {
-                            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory created: "
-                                 << COLOR_BOLD << full << COLOR_RESET << " (watch added)\n";
-                        }
-                    }
-                    if (ev->mask & IN_MOVED_FROM) {
-                        // Directory moved out or renamed - store in pending moves map
-                        // RACE CONDITION HANDLING: Cookie-based tracking ensures we can
-                        // match IN_MOVED_FROM with IN_MOVED_TO even if they arrive in
-                        // separate read() calls. Timeout cleanup handles moves out of tree.
-                        lock_guard<mutex> lk(pending_moves_mtx);
-                        pending_moves[ev->cookie] = {full, chrono::steady_clock::now()};
-                        // The entry stays in pending_moves until either a matching IN_MOVED_TO
-                        // arrives in this same event-processing thread or cleanup_stale_pending_moves()
-                        // removes it after the ~1s stale timeout.
-                    }
-                    if (ev->mask & IN_MOVED_TO) {
-                        // Directory moved in or renamed - check for matching MOVED_FROM
-                        bool found_match = false;
-                        string old_path;
-                        {
-                            lock_guard<mutex> lk(pending_moves_mtx);
-                            auto it = pending_moves.find(ev->cookie);
-                            if (it != pending_moves.end()) {
-                                old_path = it->second.first;
-                                pending_moves.erase(it);
-                                found_match = true;
-                            }
-                        }
-                        
-                        if (found_match) {
-                            // This is a rename within our watched tree
-                            // IMPORTANT: Inotify watch descriptors automatically follow directory
-                            // renames, so we don't need to remove/re-add watches. We only need to
-                            // update our internal path mappings.
-                            handle_directory_rename(old_path, full);
-                            // Inotify watch descriptors automatically follow directory renames;
-                            // no need to re-add a watch for the new path here.
-                        } else {
-                            // Moved into tree from outside - treat as new directory
-                            size_t root_idx = find_root_index(full);
-                            add_directory_recursive(full, root_idx);
-                            if (foreground) {
-                                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory created: "
-                                     << COLOR_BOLD << full << COLOR_RESET << " (moved in, watch added)\n";
-                            }
-                        }
-                    }
-                    if (ev->mask & IN_DELETE) {
-                        // Directory deleted - remove recursively
-                        remove_path(full, true);
-                        if (foreground) {
-                            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Directory deleted: "
-                                 << COLOR_BOLD << full << COLOR_RESET << " (watch removed)\n";
-                        }
-                    }
-                } else {
-                    // Process file events (non-directory)
-                    if (ev->mask & (IN_CREATE | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE)) {
-                        // File created, moved in, or modified - update index
-                        size_t root_idx = find_root_index(full);
-                        update_or_add(full, root_idx);
-                    }
-                    if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
-                        // File deleted or moved out - remove from index
-                        remove_path(full);
+                if (glob[k] == '[' && k + 1 < j && (glob[k + 1] == '=' || glob[k + 1] == '.')) return false;
+
+                unsigned char lo = static_cast<unsigned char>(glob[k]);
+                if (lo == '\\') lo = static_cast<unsigned char>(glob[++k]);
+                k++;
+                unsigned char hi = lo;
+                if (k + 1 < j && glob[k] == '-' && glob[k + 1] != ']') {
+                    k++;
+                    hi = static_cast<unsigned char>(glob[k]);
+                    if (hi == '\\') {
+                        if (k + 1 >= j) return false;
+                        hi = static_cast<unsigned char>(glob[++k]);
                     }
+                    k++;
+                    if (hi < lo) return false;
+                }
+                if (case_ins && (lo >= 0x80 || hi >= 0x80)) return false;
+                if (case_ins && lo != hi) {
+                    // Only ranges that case folding maps onto themselves
+                    bool lower_range = islower(lo) && islower(hi);
+                    bool upper_range = isupper(lo) && isupper(hi);
+                    bool no_letters = true;
+                    for (int ch = lo; ch <= hi; ch++) no_letters &= !letter(static_cast<unsigned char>(ch));
+                    if (!lower_range && !upper_range && !no_letters) return false;
                 }
+                cls += hex(lo);
+                if (hi != lo) cls += "-" + hex(hi);
+            }
+            cls += ']';
+            out += cls;
+            i = j + 1;
+        } else {
+            out += hex(c);
+            i++;
+        }
+    }
+    return true;
+}
+
+/**
+ * Struct: ContentQuery
+ * Purpose: Parameters of one content search, shared read-only by its tasks
+ */
+struct ContentQuery {
+    string pattern;
+    bool case_ins = false;
+    bool is_regex = false;
+    bool content_glob = false;
+    uint8_t before_ctx = 0;
+    uint8_t after_ctx = 0;
+    shared_ptr<RE2> re;  // Compiled pattern when is_regex
+    RegexPrefilter prefilter;  // Required literals of re
+    LiteralMatcher literal;  // Fixed-string pattern (neither regex nor glob)
+    shared_ptr<const MultiPattern> multi;  // Pattern list instead of pattern (-e/-f)
+    shared_ptr<RE2> buffer_re;  // Translated glob as a multi-line regex, when no prefilter
+    shared_ptr<ContentCacheSlot> cache;  // Results of earlier identical queries
+    bool files_only = false;  // One "path" line per matching file (-l)
+    size_t max_count = 0;     // Matches reported per file, 0 = all
+};
+
+// Append "path:lineno<sep>line\n" to a result buffer
+static void append_result_line(string& out, string_view path, size_t lineno, char sep,
+                               const char* line, size_t len) {
+    char num[24];
+    auto [end, ec] = to_chars(num, num + sizeof(num), lineno);
+    (void)ec;
+    out.append(path).append(1, ':').append(num, end).append(1, sep).append(line, len).append(1, '\n');
+}
+
+// Append "path:lineno:ids:line\n" for a pattern list, ids 1-based and comma-separated
+static void append_multi_result_line(string& out, string_view path, size_t lineno, const vector<int>& ids,
+                                     const char* line, size_t len) {
+    char num[24];
+    auto [end, ec] = to_chars(num, num + sizeof(num), lineno);
+    (void)ec;
+    out.append(path).append(1, ':').append(num, end).append(1, ':');
+    for (size_t i = 0; i < ids.size(); i++) {
+        auto [id_end, id_ec] = to_chars(num, num + sizeof(num), ids[i] + 1);
+        (void)id_ec;
+        if (i) out.append(1, ',');
+        out.append(num, id_end);
+    }
+    out.append(1, ':').append(line, len).append(1, '\n');
+}
+
+/**
+ * Function: search_contents
+ * Purpose: Search one file's contents and append its "path:lineno:line" results
+ * Parameters:
+ *   - path: File the contents belong to (prefixes each result line)
+ *   - file: The file's contents
+ *   - q: Content query
+ *   - out: Result buffer (lines are appended)
+ *   - marks: Receives the offset in out where each match's output starts
+ *            (its "--", before-context and line); cutting out at a mark
+ *            keeps the earlier matches with their after-context
+ *   - cancel: Optional flag; once set the scan stops at the next line
+ * Returns: false if the scan was cancelled before the end of the file
+ * Security: Files with a NUL byte in the first 1KB are treated as binary
+ *           and skipped
+ * Thread-safety: Thread-safe (file is the caller's, q is only read)
+ * 
+ * Content Search Algorithm:
+ * 1. The caller reads the file (FileContents: pread() if small, else
+ *    memory-mapped; or a buffer filled by FilePrefetcher)
+ * 2. Check for binary data in first 1KB (skip binary files)
+ * 3. Find matching lines in one forward pass. Literals are searched in the
+ *    whole buffer (LiteralMatcher), as are a regex's required literals
+ *    (RegexPrefilter), a pattern list's automaton and a translated glob's
+ *    multi-line regex; lines are only located around hits. Other patterns
+ *    are matched line by line in place.
+ * 4. Context lines are streamed around each match: before-context is found
+ *    by stepping back at most B lines (never past the last printed line),
+ *    after-context by a countdown flushed when the next match or EOF is
+ *    reached. Nothing is allocated per line; files without a match cost
+ *    the same with or without context.
+ * 5. The scan stops at the first match with q.files_only and after
+ *    q.max_count matches (trailing after-context is still emitted).
+ * 
+ * Pattern Matching Methods:
+ * - Fixed string: LiteralMatcher::find() (SIMD, ASCII case folding for -i)
+ * - Regex: RE2::PartialMatch() (thread-safe), behind the prefilter
+ * - Glob: translated to an anchored regex (glob_to_regex()) when exact,
+ *   otherwise fnmatch() with FNM_CASEFOLD for case-insensitive
+ * - Pattern list: MultiPattern::match_line()
+ */
+static bool search_contents(string_view path, const FileContents& file, const ContentQuery& q, string& out,
+                            vector<size_t>& marks, const atomic<bool>* cancel) {
+    if (!file.is_valid()) return true;
+    
+    // SECURITY: Binary file detection - scan first 1KB for null bytes
+    // This prevents displaying binary files as text (can cause terminal corruption)
+    size_t check = min<size_t>(1024, file.size);
+    bool binary = false;
+    for (size_t i = 0; i < check; i++) {
+        if (file.data[i] == '\0') {
+            binary = true;
+            break;
+        }
+    }
+    if (binary) return true;  // Skip binary files
+    
+    bool plain_literal = !q.content_glob && !q.is_regex && !q.multi;
+    bool prefiltered = q.is_regex && q.prefilter.active();
+    bool whole_buffer_re = q.buffer_re != nullptr;  // Each match is exactly one matching line
+    bool multi_skips = q.multi && q.multi->skips_lines();
+    // A literal containing '\n' can never match within one line
+    if (plain_literal && q.pattern.find('\n') != string::npos) return true;
+    
+    const char* end = file.data + file.size;
+    const char* pos = file.data;  // Start of the unsearched remainder (a line start)
+    size_t lineno = 1;            // Line number of pos
+    vector<int> ids, atoms;       // Pattern list ids of the current match, scratch
+    string line_str;              // NUL-terminated line for the fnmatch() fallback, reused
+    vector<const char*> next_hit(q.prefilter.any_of.size(), nullptr);  // Per literal, end = none left
+    
+    // First position at or after pos that can start a match, or nullptr.
+    // Only used when matches are found by scanning the whole buffer.
+    auto find_hit = [&]() -> const char* {
+        if (plain_literal) return q.literal.find(pos, end - pos);
+        if (whole_buffer_re) {
+            re2::StringPiece m;
+            bool found = q.buffer_re->Match(re2::StringPiece(file.data, file.size), pos - file.data, file.size,
+                                            RE2::UNANCHORED, &m, 1);
+            return found && m.data() < end ? m.data() : nullptr;  // Not the empty "line" after a final '\n'
+        }
+        if (multi_skips) return q.multi->automaton.find_end(pos, end - pos);
+        const char* hit = end;
+        for (size_t i = 0; i < next_hit.size(); i++) {
+            if (!next_hit[i] || next_hit[i] < pos) {
+                const char* h = q.prefilter.any_of[i].find(pos, end - pos);
+                next_hit[i] = h ? h : end;
+            }
+            hit = min(hit, next_hit[i]);
+        }
+        return hit == end ? nullptr : hit;
+    };
+    bool scan_buffer = plain_literal || prefiltered || whole_buffer_re || multi_skips;
+    bool hit_is_match = plain_literal || whole_buffer_re;
+    
+    auto line_matches = [&](const char* line, size_t len) {
+        if (q.multi) {
+            q.multi->match_line(line, len, ids, atoms);
+            return !ids.empty();
+        }
+        if (q.content_glob) {
+            line_str.assign(line, len);
+            int fnm_flags_content = q.case_ins ? FNM_CASEFOLD : 0;
+            return fnmatch(q.pattern.c_str(), line_str.c_str(), fnm_flags_content) == 0;
+        }
+        if (q.is_regex) return RE2::PartialMatch(re2::StringPiece(line, len), *q.re);
+        return q.literal.find(line, len) != nullptr;
+    };
+    
+    // Advance to the next matching line; on success [line_start, line_end)
+    // is the line (without '\n') and match_lineno its number
+    const char* line_start = nullptr;
+    const char* line_end = nullptr;
+    size_t match_lineno = 0;
+    size_t matches_left = q.files_only ? 1 : q.max_count ? q.max_count : SIZE_MAX;
+    bool cancelled = false;
+    auto next_match = [&]() {
+        while (pos < end && matches_left > 0) {
+            if (cancel && cancel->load(memory_order_relaxed)) {
+                cancelled = true;
+                break;
+            }
+            line_start = pos;
+            if (scan_buffer) {
+                const char* hit = find_hit();
+                if (!hit) break;
+                const char* nl = static_cast<const char*>(memrchr(pos, '\n', hit - pos));
+                if (nl) line_start = nl + 1;
+                lineno += count_newlines(pos, line_start - pos);
             }
-        } else if (len < 0 && errno != EAGAIN) break;
+            line_end = static_cast<const char*>(memchr(line_start, '\n', end - line_start));
+            if (!line_end) line_end = end;
+            pos = line_end == end ? end : line_end + 1;
+            bool match = hit_is_match || line_matches(line_start, line_end - line_start);
+            match_lineno = lineno++;
+            if (match) {
+                matches_left--;
+                return true;
+            }
+        }
+        pos = end;
+        return false;
+    };
+    
+    auto append_match = [&]() {
+        if (q.files_only) {
+            out.append(path).append(1, '\n');
+        } else if (q.multi) {
+            append_multi_result_line(out, path, match_lineno, ids, line_start, line_end - line_start);
+        } else {
+            append_result_line(out, path, match_lineno, ':', line_start, line_end - line_start);
+        }
+    };
+    
+    if ((q.before_ctx == 0 && q.after_ctx == 0) || q.files_only) {
+        while (next_match()) {
+            marks.push_back(out.size());
+            append_match();
+        }
+        return !cancelled;
+    }
+    
+    // Context output: overlapping or adjacent groups merge, others are
+    // separated by "--" as in grep
+    size_t last_printed = 0;       // Line number of the last emitted line (0 = none)
+    const char* after_ptr = nullptr;  // Start of the next after-context line
+    size_t after_lineno = 0;
+    size_t after_left = 0;         // After-context lines still owed to the last match
+    auto append_context = [&](const char* line, size_t number) {
+        const char* nl = static_cast<const char*>(memchr(line, '\n', end - line));
+        const char* stop = nl ? nl : end;
+        append_result_line(out, path, number, '-', line, stop - line);
+        last_printed = number;
+        return nl ? nl + 1 : end;
+    };
+    // Emit owed after-context lines numbered below limit
+    auto flush_after = [&](size_t limit) {
+        while (after_left > 0 && after_lineno < limit && after_ptr < end) {
+            after_ptr = append_context(after_ptr, after_lineno++);
+            after_left--;
+        }
+        if (after_lineno >= limit || after_ptr >= end) after_left = 0;
+    };
+    
+    while (next_match()) {
+        flush_after(match_lineno);
+        marks.push_back(out.size());
+        
+        // Step back over at most before_ctx lines not printed yet
+        const char* before = line_start;
+        size_t before_lineno = match_lineno;
+        while (before_lineno > 1 && match_lineno - before_lineno < q.before_ctx && before_lineno - 1 > last_printed) {
+            const char* nl = static_cast<const char*>(memrchr(file.data, '\n', (before - 1) - file.data));
+            before = nl ? nl + 1 : file.data;
+            before_lineno--;
+        }
+        if (last_printed && before_lineno > last_printed + 1) out.append("--\n");
+        while (before_lineno < match_lineno) before = append_context(before, before_lineno++);
+        
+        append_match();
+        last_printed = match_lineno;
+        after_ptr = pos;
+        after_lineno = match_lineno + 1;
+        after_left = q.after_ctx;
+    }
+    flush_after(SIZE_MAX);
+    return !cancelled;
+}
+
+/**
+ * Function: search_file
+ * Purpose: Read one file and search it (see search_contents())
+ * Parameters:
+ *   - path, q, out, marks, cancel: As for search_contents()
+ *   - st: The caller's stat() of path, or nullptr (see FileContents)
+ * Returns: false if the scan was cancelled before the end of the file
+ * Thread-safety: Thread-safe (own mapping or per-thread buffer)
+ */
+static bool search_file(const EntryPath& path, const ContentQuery& q, string& out, vector<size_t>& marks,
+                        const atomic<bool>* cancel, const struct stat* st) {
+    FileContents file(path, st);
+    return search_contents(path, file, q, out, marks, cancel);
+}
+
+// Size-aware batching: consecutive candidates share one task until their
+// combined size or count reaches a limit, so hundreds of thousands of small
+// files cost a few thousand scheduler operations. Large files run alone.
+const size_t SEARCH_BATCH_BYTES = 256 * 1024;
+const size_t SEARCH_BATCH_FILES = 64;
+
+// Ordered mode keeps at most this many batches submitted past the oldest
+// unsent one, bounding the memory held for out-of-order completions.
+const size_t REORDER_WINDOW_BATCHES = 64;
+// Unordered mode hands a worker's buffer to the sender once it is this large
+const size_t STREAM_CHUNK_BYTES = 64 * 1024;
+
+// While waiting for workers, the sender checks this often whether the client
+// has gone away
+const auto CLIENT_POLL_INTERVAL = chrono::milliseconds(20);
+// A write to a client that has not read anything for this long fails
+const int CLIENT_SEND_TIMEOUT_SEC = 30;
+
+// True once the client has closed its end of the connection. A closed Unix
+// stream peer raises POLLHUP; a mere shutdown(SHUT_WR) does not.
+static bool client_hung_up(int fd) {
+    struct pollfd p {};
+    p.fd = fd;
+    return poll(&p, 1, 0) > 0 && (p.revents & (POLLHUP | POLLERR));
+}
+
+/**
+ * Struct: ContentSearchJob
+ * Purpose: Per-query result channel between search workers and the sender
+ * 
+ * Ordered mode: each batch appends to its own buffer and marks itself done;
+ * the sender writes buffers strictly in batch order. Unordered mode: workers
+ * push filled buffers onto 'ready' and the sender writes them as they come.
+ * 
+ * With a result limit, ordered mode counts matches at the sender (marks say
+ * where to cut a buffer); unordered workers claim matches from 'remaining'
+ * as each file finishes. Reaching the limit sets 'cancel', which stops the
+ * running scans, and the tasks still queued are removed from the pool.
+ */
+struct ContentSearchJob {
+    const ContentQuery& query;
+    const vector<const Entry*>& files;
+    bool ordered = true;
+    vector<pair<uint32_t, uint32_t>> batches;  // [first, last) ranges of files
+    vector<string> results;                    // Ordered: one buffer per batch
+    vector<vector<size_t>> marks;              // Ordered: match offsets per buffer
+    vector<uint8_t> done;                      // Ordered: protected by lock
+    deque<string> ready;                       // Unordered: protected by lock
+    size_t finished = 0;                       // Unordered: protected by lock
+    bool limited = false;                      // Unordered: a result limit applies
+    atomic<size_t> remaining{SIZE_MAX};        // Unordered: matches still allowed
+    atomic<bool> cancel{false};                // Result limit reached or search stopped
+    atomic<size_t> cache_hits{0};              // Files answered from the result cache
+    atomic<size_t> searched{0};                // Files scanned to the end
+    mutex lock;
+    condition_variable cv;
+    
+    ContentSearchJob(const ContentQuery& q, const vector<const Entry*>& f) : query(q), files(f) {}
+    
+    // Take up to 'found' matches from the limit; the caller that takes the
+    // last one cancels the rest of the search
+    size_t claim(size_t found) {
+        size_t left = remaining.load();
+        size_t take;
+        do {
+            take = min(found, left);
+        } while (!remaining.compare_exchange_weak(left, left - take));
+        if (take > 0 && left == take) stop_queued();
+        return take;
     }
+    
+    // Set cancel and retire the tasks no worker has started
+    void stop_queued() {
+        cancel = true;
+        vector<uint32_t> removed;
+        content_search_pool->cancel(this, removed);
+        lock_guard<mutex> lk(lock);
+        for (uint32_t index : removed) {
+            if (ordered) done[index] = 1; else finished++;
+        }
+        cv.notify_one();
+    }
+};
+
+/**
+ * Function: content_cache_find
+ * Purpose: Append a file's results from the query's result cache if the
+ *          file is unchanged since it was last scanned
+ * Parameters:
+ *   - path: File to search
+ *   - q: Content query (q.cache must be set)
+ *   - st: The file's current identity (stat() of a regular file)
+ *   - out, marks: As for search_file()
+ * Returns: true on a hit
+ * Thread-safety: Called from worker threads; takes only the slot lock
+ */
+static bool content_cache_find(string_view path, const ContentQuery& q, const struct stat& st, string& out,
+                               vector<size_t>& marks) {
+    int64_t mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    ContentCacheSlot& slot = *q.cache;
+    lock_guard<mutex> lk(slot.lock);
+    auto it = slot.files.find(path);
+    if (it == slot.files.end() || it->second.size != st.st_size || it->second.mtime_ns != mtime_ns ||
+        it->second.ino != st.st_ino) {
+        return false;
+    }
+    for (uint32_t mark : it->second.marks) marks.push_back(out.size() + mark);
+    out += it->second.results;
+    return true;
 }
 
 /**
- * Class: MappedFile
- * Purpose: RAII wrapper for memory-mapped files used in content search
+ * Function: content_cache_store
+ * Purpose: Keep the results of a completed scan in the query's result cache
+ * Parameters:
+ *   - path: File that was searched
+ *   - q: Content query (q.cache must be set)
+ *   - st: The file's identity, taken before it was read
+ *   - out, before: The scan appended out[before, end)
+ *   - marks, first_mark: The scan appended marks[first_mark, end)
+ * Returns: void (the results are dropped when over CONTENT_CACHE_BYTES)
+ * Thread-safety: Called from worker threads; takes only the slot lock
  * 
- * Security Considerations:
- * - Uses MAP_PRIVATE to prevent modifications from affecting original file
- * - Handles errors gracefully (returns invalid on any failure)
- * - Empty files are handled correctly (valid but no data)
- * - madvise() failure is non-fatal (advisory only)
+ * Taking the identity before the read means a file modified while it is
+ * being read is stored under its old identity and rescanned next time.
+ */
+static void content_cache_store(string_view path, const ContentQuery& q, const struct stat& st, const string& out,
+                                size_t before, const vector<size_t>& marks, size_t first_mark) {
+    int64_t mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    ContentCacheSlot& slot = *q.cache;
+    size_t found = marks.size() - first_mark;
+    size_t cost = path.size() + (out.size() - before) + found * sizeof(uint32_t) + CONTENT_CACHE_ENTRY_OVERHEAD;
+    
+    lock_guard<mutex> lk(slot.lock);
+    auto it = slot.files.find(path);
+    if (it != slot.files.end()) {
+        size_t old_cost = path.size() + it->second.results.size() + it->second.marks.size() * sizeof(uint32_t) +
+                          CONTENT_CACHE_ENTRY_OVERHEAD;
+        slot.bytes -= old_cost;
+        content_cache_bytes -= old_cost;
+        slot.files.erase(it);
+    }
+    if (content_cache_bytes + cost > CONTENT_CACHE_BYTES) return;
+    CachedFileResult entry{st.st_size, mtime_ns, st.st_ino, out.substr(before), {}};
+    entry.marks.reserve(found);
+    for (size_t i = first_mark; i < marks.size(); i++) entry.marks.push_back(static_cast<uint32_t>(marks[i] - before));
+    slot.files.emplace(string(path), move(entry));
+    slot.bytes += cost;
+    content_cache_bytes += cost;
+}
+
+/**
+ * Function: search_file_cached
+ * Purpose: Search one file, answering from the query's result cache when the
+ *          file is unchanged since it was last scanned
+ * Parameters:
+ *   - path: File to search
+ *   - q: Content query (q.cache may be null)
+ *   - out, marks, cancel: As for search_file()
+ * Returns: true if the results came from the cache
+ * Thread-safety: Called from worker threads; takes only the slot lock
  * 
- * Memory Safety:
- * - RAII: Automatically unmaps and closes on destruction
- * - Copy-prevention: Deleted copy constructor and assignment
- * - Move semantics: Not implemented (each thread creates its own)
+ * Files that are not regular are skipped. Cancelled scans are not stored.
+ */
+static bool search_file_cached(const EntryPath& path, const ContentQuery& q, string& out, vector<size_t>& marks,
+                               const atomic<bool>* cancel) {
+    struct stat st;
+    if (!q.cache) {
+        search_file(path, q, out, marks, cancel, nullptr);
+        return false;
+    }
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    if (content_cache_find(path, q, st, out, marks)) return true;
+    
+    size_t before = out.size();
+    size_t first_mark = marks.size();
+    if (search_file(path, q, out, marks, cancel, &st)) {
+        content_cache_store(path, q, st, out, before, marks, first_mark);
+    }
+    return false;
+}
+
+#ifdef HAVE_IO_URING
+// Each worker keeps up to this many small files of its batch queued ahead
+// (stat, open and read in flight), and at most this many bytes of them by
+// indexed size
+constexpr unsigned PREFETCH_FILES = 32;
+constexpr size_t PREFETCH_BYTES = 1024 * 1024;
+
+/**
+ * Class: FilePrefetcher
+ * Purpose: Read the next small files of a search batch through the
+ *          worker's io_uring while the current one is searched
  * 
- * Thread-safety: Not thread-safe (each thread creates its own instance)
+ * Each file below SMALL_FILE_READ_BYTES (by indexed size) is queued as a
+ * STATX, so on a cold cache the inode reads reach queue depth too. When
+ * it completes, a result cache hit, or a file that is not regular or has
+ * grown large, is settled without further I/O (the latter by
+ * search_file_cached() when reached); special files are never opened.
+ * The rest get an OPENAT, and once it completes a READ into the slot's
+ * buffer, sized to the stat()ed size plus one byte so an unchanged file
+ * ends in a short read. Files are searched strictly in batch order, so
+ * the output is the same as with synchronous reads; large files are
+ * mapped by search_file_cached() when their turn comes while the queue
+ * keeps the following small files in flight.
  * 
- * Implementation Notes:
- * - Uses mmap() for efficient file reading without copying to userspace
- * - MADV_SEQUENTIAL hints kernel for better readahead
- * - Fallback gracefully if mmap() fails (returns invalid)
+ * After start() the caller runs search() for each file in order and then
+ * finish(), which waits out requests still in flight (the batch may stop
+ * early) and closes their files. The slot buffers are reused across
+ * batches (at most PREFETCH_FILES x SMALL_FILE_READ_BYTES per worker).
  * 
- * REVIEWER_NOTE: This is the core of efficient content search. By using mmap(),
- * we avoid copying file contents into userspace buffers. The kernel provides
- * the pages directly from its page cache.
+ * An io_uring_enter() failure marks the prefetcher broken: requests in
+ * flight keep their slots (and buffers) for good, files already opened
+ * are closed by finish(), and every remaining file is read synchronously.
+ * 
+ * Thread-safety: Not thread-safe (one instance per worker thread)
  */
-struct MappedFile {
-    char* data;
-    size_t size;
-    int fd;
+class FilePrefetcher {
+public:
+    bool init(string& why) {
+        for (unsigned s = 0; s < PREFETCH_FILES; s++) free_slots.push_back(s);
+        return ring.init(PREFETCH_FILES, why);
+    }
     
-    MappedFile(const string& path) : data(nullptr), size(0), fd(-1) {
-        fd = open(path.c_str(), O_RDONLY);
-        if (fd < 0) return;
-        
-        struct stat st;
-        if (fstat(fd, &st) != 0) {
-            close(fd);
-            fd = -1;
-            return;
+    bool broken() const { return failed; }
+    
+    void start(const vector<const Entry*>& batch_files, const ContentQuery& q, const atomic<bool>* stop,
+               uint32_t first, uint32_t last) {
+        files = &batch_files;
+        query = &q;
+        cancel = stop;
+        next = first;
+        end = last;
+        queued_bytes = 0;
+        top_up();
+    }
+    
+    // Search file i, the batch's next one; as search_file_cached()
+    bool search(uint32_t i, string& out, vector<size_t>& marks) {
+        const Entry* e = (*files)[i];
+        next = max(next, i);
+        top_up();
+        if (queue.empty() || slots[queue.front()].file != i) {
+            return search_file_cached(e->path, *query, out, marks, cancel);
         }
-        
-        size = st.st_size;
-        if (size == 0) {
-            // Empty files are valid - we'll just have no content to search
-            // Keep fd open for consistency but data will be nullptr
-            close(fd);
-            fd = -1;
+        uint32_t s = queue.front();
+        while (slots[s].state != READY && !failed) wait();
+        if (slots[s].state != READY) return search_file_cached(e->path, *query, out, marks, cancel);
+        queue.pop_front();
+        queued_bytes -= slots[s].queued_bytes;
+        top_up();  // Refill before searching, so the reads overlap the scan
+        free_slots.push_back(s);  // Reused no earlier than the next top_up()
+        return search_slot(slots[s], out, marks);
+    }
+    
+    void finish() {
+        // After a failure nothing is waited for, but opens that have
+        // already completed still hand over their fds
+        if (failed) ring.reap([&](const io_uring_cqe& cqe) { complete(cqe); });
+        while (!queue.empty()) {
+            Slot& slot = slots[queue.front()];
+            if (slot.state != READY && !failed) {
+                wait();
+                continue;
+            }
+            if (slot.fd >= 0) close(slot.fd);
+            slot.fd = -1;
+            // A request still in flight may write to the buffer: never reuse
+            if (slot.state == READY) free_slots.push_back(queue.front());
+            queue.pop_front();
+        }
+    }
+    
+private:
+    enum State : uint8_t { STATING, OPENING, READING, READY };
+    struct Slot {
+        uint32_t file = 0;        // Index into *files
+        State state = READY;
+        bool sync = false;        // Left to search_file_cached()
+        bool hit = false;         // Answered from the result cache (in cached)
+        int fd = -1;
+        int error = 0;            // A failed stat, open or read
+        struct statx stx;         // Filled by the STATX request
+        struct stat st;           // Identity for the result cache (from stx)
+        size_t queued_bytes = 0;  // Indexed size, counted in PREFETCH_BYTES
+        string buf;               // buf[0, len) holds the file
+        size_t len = 0;
+        string cached;            // Cache hit: results and their marks
+        vector<size_t> cached_marks;
+    };
+    
+    IoUring ring;
+    Slot slots[PREFETCH_FILES];
+    deque<uint32_t> queue;         // Slots of queued files, in batch order
+    vector<uint32_t> free_slots;
+    const vector<const Entry*>* files = nullptr;
+    const ContentQuery* query = nullptr;
+    const atomic<bool>* cancel = nullptr;
+    uint32_t next = 0, end = 0;    // Next file to queue, end of the batch
+    size_t queued_bytes = 0;
+    bool failed = false;
+    
+    // Queue files until the slots or PREFETCH_BYTES run out, and submit
+    // them along with opens and reads queued by earlier completions
+    void top_up() {
+        while (next < end && !free_slots.empty() && !failed && !cancel->load(memory_order_relaxed)) {
+            const Entry* e = (*files)[next];
+            if (e->size < 0 || static_cast<uint64_t>(e->size) >= SMALL_FILE_READ_BYTES) {
+                next++;  // Mapped when its turn comes
+                continue;
+            }
+            size_t size = static_cast<size_t>(e->size);
+            if (!queue.empty() && queued_bytes + size > PREFETCH_BYTES) break;
+            uint32_t s = free_slots.back();
+            free_slots.pop_back();
+            Slot& slot = slots[s];
+            slot.file = next++;
+            slot.state = READY;
+            slot.sync = slot.hit = false;
+            slot.fd = -1;
+            slot.error = 0;
+            slot.len = 0;
+            slot.queued_bytes = size;
+            queued_bytes += size;
+            queue.push_back(s);
+            
+            io_uring_sqe* sqe = ring.get_sqe();
+            if (!sqe) {
+                slot.sync = true;
+                continue;
+            }
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(e->path.c_str());
+            sqe->len = STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_MTIME;
+            sqe->off = reinterpret_cast<uint64_t>(&slot.stx);
+            sqe->user_data = s;
+            slot.state = STATING;
+        }
+        if (!failed && !ring.submit(0)) fail();
+    }
+    
+    // Submit what is queued and handle at least one completion
+    void wait() {
+        if (!ring.submit(1)) {
+            fail();
             return;
         }
-        
-        data = static_cast<char*>(mmap(nullptr, size, PROT_READ, 
-                                       MAP_PRIVATE, fd, 0));
-        if (data == MAP_FAILED) {
-            data = nullptr;
-            close(fd);
-            fd = -1;
+        ring.reap([&](const io_uring_cqe& cqe) { complete(cqe); });
+    }
+    
+    void complete(const io_uring_cqe& cqe) {
+        Slot& slot = slots[cqe.user_data];
+        if (cqe.res < 0) {
+            slot.error = -cqe.res;
+            slot.state = READY;
             return;
         }
-        
-        // Hint: we'll read sequentially
-        // madvise is advisory, failure is non-fatal
-        if (madvise(data, size, MADV_SEQUENTIAL) != 0) {
-            // Continue anyway - this is just a performance hint
+        if (slot.state == STATING) {
+            stated(slot, cqe.user_data);
+        } else if (slot.state == OPENING) {
+            slot.fd = cqe.res;
+            if (failed) {
+                slot.state = READY;  // Closed by finish()
+                return;
+            }
+            size_t want = max(static_cast<size_t>(slot.st.st_size) + 1, static_cast<size_t>(4096));
+            if (slot.buf.size() < want) slot.buf.resize(want);
+            io_uring_sqe* sqe = ring.get_sqe();
+            if (!sqe) {
+                ssize_t got = pread_to_eof(slot.fd, slot.buf, 0, SMALL_FILE_READ_BYTES - 1);
+                if (got < 0) slot.error = errno; else slot.len = static_cast<size_t>(got);
+                slot.state = READY;
+                return;
+            }
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = slot.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(slot.buf.data());
+            sqe->len = static_cast<uint32_t>(slot.buf.size());
+            sqe->off = 0;
+            sqe->user_data = cqe.user_data;
+            slot.state = READING;  // Submitted by the next top_up() or wait()
+        } else {
+            slot.len = static_cast<size_t>(cqe.res);
+            slot.state = READY;
         }
     }
     
-    ~MappedFile() {
-        if (data) munmap(data, size);
-        if (fd >= 0) close(fd);
+    // STATX done: settle the file from its identity, or open it
+    void stated(Slot& slot, uint64_t s) {
+        const Entry* e = (*files)[slot.file];
+        slot.state = READY;
+        memset(&slot.st, 0, sizeof(slot.st));
+        slot.st.st_mode = slot.stx.stx_mode;
+        slot.st.st_ino = slot.stx.stx_ino;
+        slot.st.st_size = static_cast<off_t>(slot.stx.stx_size);
+        slot.st.st_mtim.tv_sec = slot.stx.stx_mtime.tv_sec;
+        slot.st.st_mtim.tv_nsec = slot.stx.stx_mtime.tv_nsec;
+        if (!S_ISREG(slot.st.st_mode) || slot.stx.stx_size >= SMALL_FILE_READ_BYTES || failed) {
+            slot.sync = true;
+            return;
+        }
+        if (query->cache) {
+            slot.cached.clear();
+            slot.cached_marks.clear();
+            if (content_cache_find(e->path, *query, slot.st, slot.cached, slot.cached_marks)) {
+                slot.hit = true;
+                return;
+            }
+        }
+        io_uring_sqe* sqe = ring.get_sqe();
+        if (!sqe) {
+            slot.sync = true;
+            return;
+        }
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(e->path.c_str());
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = s;
+        slot.state = OPENING;  // Submitted by the next top_up() or wait()
     }
     
-    bool is_valid() const { return data != nullptr; }
+    void fail() {
+        failed = true;
+        cerr << COLOR_YELLOW << "[WARNING]" << COLOR_RESET << " io_uring_enter failed (" << strerror(errno)
+             << "), content search falls back to synchronous reads on this thread\n";
+    }
     
-    // Prevent copying
-    MappedFile(const MappedFile&) = delete;
-    MappedFile& operator=(const MappedFile&) = delete;
+    bool search_slot(Slot& slot, string& out, vector<size_t>& marks) {
+        const Entry* e = (*files)[slot.file];
+        if (slot.sync) return search_file_cached(e->path, *query, out, marks, cancel);
+        if (slot.hit) {
+            for (size_t mark : slot.cached_marks) marks.push_back(out.size() + mark);
+            out += slot.cached;
+            return true;
+        }
+        if (slot.fd >= 0) {
+            // A full buffer means the file grew since it was stat()ed
+            if (!slot.error && slot.len == slot.buf.size()) {
+                ssize_t got = pread_to_eof(slot.fd, slot.buf, slot.len, SMALL_FILE_READ_BYTES - 1);
+                if (got < 0) slot.error = errno; else slot.len = static_cast<size_t>(got);
+            }
+            close(slot.fd);
+            slot.fd = -1;
+        }
+        if (slot.error) return false;  // Unreadable, like a failed open() in search_file()
+        // Grown large since it was stat()ed: mapped like any large file
+        if (slot.len >= SMALL_FILE_READ_BYTES) return search_file_cached(e->path, *query, out, marks, cancel);
+        
+        size_t before = out.size();
+        size_t first_mark = marks.size();
+        FileContents file(slot.buf.data(), slot.len);
+        if (search_contents(e->path, file, *query, out, marks, cancel) && query->cache) {
+            content_cache_store(e->path, *query, slot.st, out, before, marks, first_mark);
+        }
+        return false;
+    }
+};
+
+static atomic<bool> io_uring_unavailable{false};
+#endif
+
+// The calling worker's prefetcher, set up on first use; nullptr when
+// io_uring is off, unavailable or has failed on this thread
+#ifdef HAVE_IO_URING
+static FilePrefetcher* file_prefetcher() {
+    static thread_local unique_ptr<FilePrefetcher> prefetcher;
+    static thread_local bool tried = false;
+    if (!use_io_uring || io_uring_unavailable.load(memory_order_relaxed)) return nullptr;
+    if (!tried) {
+        tried = true;
+        auto p = make_unique<FilePrefetcher>();
+        string why;
+        if (p->init(why)) {
+            prefetcher = move(p);
+        } else if (!io_uring_unavailable.exchange(true)) {
+            cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " io_uring unavailable (" << why
+                 << "), content search reads files synchronously\n";
+        }
+    }
+    return prefetcher && !prefetcher->broken() ? prefetcher.get() : nullptr;
+}
+#endif
+
+static void run_search_batch(void* ctx, uint32_t index) {
+    auto* job = static_cast<ContentSearchJob*>(ctx);
+    auto [first, last] = job->batches[index];
+    string local;
+    vector<size_t> local_marks;
+    string& out = job->ordered ? job->results[index] : local;
+    vector<size_t>& marks = job->ordered ? job->marks[index] : local_marks;
+#ifdef HAVE_IO_URING
+    FilePrefetcher* prefetch = file_prefetcher();
+    if (prefetch) prefetch->start(job->files, job->query, &job->cancel, first, last);
+#endif
+    for (uint32_t i = first; i < last && !job->cancel.load(memory_order_relaxed); i++) {
+        size_t file_start = out.size();
+        try {
+            const Entry* e = job->files[i];
+#ifdef HAVE_IO_URING
+            bool hit = prefetch ? prefetch->search(i, out, marks)
+                                : search_file_cached(e->path, job->query, out, marks, &job->cancel);
+#else
+            bool hit = search_file_cached(e->path, job->query, out, marks, &job->cancel);
+#endif
+            if (hit) job->cache_hits++;
+            if (!job->cancel.load(memory_order_relaxed)) job->searched++;
+        } catch (const exception& e) {
+            // Log error but continue with other files
+            if (foreground) {
+                cerr << COLOR_YELLOW << "[WARNING]" << COLOR_RESET 
+                     << " Worker thread error: " << e.what() << "\n";
+            }
+        }
+        if (job->limited) {
+            size_t found = marks.size();
+            size_t take = found ? job->claim(found) : 0;
+            if (take < found) out.resize(take ? marks[take] : file_start);
+        }
+        if (!job->ordered) marks.clear();
+        if (!job->ordered && out.size() >= STREAM_CHUNK_BYTES) {
+            {
+                lock_guard<mutex> lk(job->lock);
+                job->ready.push_back(move(out));
+            }
+            out.clear();
+            job->cv.notify_one();
+        }
+    }
+#ifdef HAVE_IO_URING
+    if (prefetch) prefetch->finish();
+#endif
+    // Notify under the lock: the sender may destroy the job as soon as it
+    // observes the last completion
+    lock_guard<mutex> lk(job->lock);
+    if (job->ordered) {
+        job->done[index] = 1;
+    } else {
+        if (!out.empty()) job->ready.push_back(move(out));
+        job->finished++;
+    }
+    job->cv.notify_one();
+}
+
+/**
+ * Struct: ContentSearchStats
+ * Purpose: What run_content_search() did, for the caller's status lines and logs
+ */
+struct ContentSearchStats {
+    size_t cache_hits = 0;          // Files answered from the result cache
+    size_t searched = 0;            // Files scanned to the end
+    bool deadline_reached = false;  // Stopped at the query deadline
+    bool budget_reached = false;    // Stopped at the result byte budget
 };
 
 /**
- * Function: send_results_batched
- * Purpose: Send search results to client using batched writev() for efficiency
+ * Function: run_content_search
+ * Purpose: Search the contents of candidate files on the worker pool and
+ *          stream the results to a client
  * Parameters:
- *   - fd: Client socket file descriptor
- *   - results: Vector of result strings to send
- * Returns: void
- * Security:
- *   - Handles EINTR correctly in writev() loop
- *   - Handles partial writes correctly
- *   - No buffer overflow risk (sends only complete strings)
- * Thread-safety: Thread-safe (each client has unique fd)
+ *   - fd: Client socket
+ *   - q: Content query
+ *   - files: Candidate entries (caller keeps them alive, i.e. holds mtx)
+ *   - ordered: true for results in candidate order, false to send each
+ *              buffer as soon as a worker fills it
+ *   - max_results: Matches to send in total, 0 = all. Ordered mode sends
+ *                  the first ones in candidate order.
+ *   - deadline: Stop sending once this time has passed
+ *               (time_point::max() = none)
+ *   - max_bytes: Result bytes to send in total, 0 = all. The output is cut
+ *                after the last whole line that fits.
+ * Returns: Statistics, taken after every task has finished
+ * Thread-safety: Called from a client handler thread
  * 
- * Performance Notes:
- * - Uses writev() to batch multiple strings into fewer syscalls
- * - Reduces context switches compared to individual write() calls
- * - Batches up to 1024 iovecs at a time (typical IOV_MAX on Linux)
- * - Handles partial writes by adjusting iovec pointers
+ * In ordered mode only REORDER_WINDOW_BATCHES batches are submitted ahead of
+ * the oldest unsent one; a new batch is submitted each time one is sent.
  * 
- * REVIEWER_NOTE: This function implements the gather I/O pattern for efficiency.
- * The partial write handling is complex but correct.
+ * A failed write (EPIPE, or the send timeout set by handle_client()), a
+ * hangup seen while waiting for results, the deadline and the byte budget
+ * all cancel the search like a reached limit: scans stop at their next line
+ * and queued batches are dropped, so the query releases mtx within
+ * milliseconds. The deadline is checked between buffers and at least every
+ * CLIENT_POLL_INTERVAL while waiting.
  */
-void send_results_batched(int fd, const vector<string>& results) {
-    if (results.empty()) return;
-    
-    const size_t MAX_IOV = 1024;  // Typical IOV_MAX on Linux
-    vector<struct iovec> iov;
-    iov.reserve(MAX_IOV);
+ContentSearchStats run_content_search(int fd, const ContentQuery& q, const vector<const Entry*>& files,
+                                      bool ordered, size_t max_results,
+                                      chrono::steady_clock::time_point deadline, size_t max_bytes) {
+    ContentSearchJob job(q, files);
+    job.ordered = ordered;
+    uint32_t first = 0;
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < files.size(); i++) {
+        size_t size = files[i]->size > 0 ? static_cast<size_t>(files[i]->size) : 0;
+        if (size >= SEARCH_BATCH_BYTES && i > first) {
+            job.batches.emplace_back(first, i);
+            first = i;
+            bytes = 0;
+        }
+        bytes += size;
+        if (bytes >= SEARCH_BATCH_BYTES || i + 1 - first >= SEARCH_BATCH_FILES) {
+            job.batches.emplace_back(first, i + 1);
+            first = i + 1;
+            bytes = 0;
+        }
+    }
+    if (first < files.size()) job.batches.emplace_back(first, static_cast<uint32_t>(files.size()));
+    
+    size_t n = job.batches.size();
+    vector<PoolTask> tasks(n);
+    for (size_t b = 0; b < n; b++) tasks[b] = PoolTask{run_search_batch, &job, static_cast<uint32_t>(b)};
+    
+    ContentSearchStats stats;
+    bool client_gone = false;
+    // Wait on the job in slices of at most CLIENT_POLL_INTERVAL, checking
+    // that the client is still connected and the deadline has not passed;
+    // false if the search has to stop
+    auto wait_for_job = [&](unique_lock<mutex>& lk, auto ready) {
+        while (true) {
+            auto now = chrono::steady_clock::now();
+            if (now >= deadline) {
+                stats.deadline_reached = true;
+                return false;
+            }
+            auto slice = min<chrono::steady_clock::duration>(CLIENT_POLL_INTERVAL, deadline - now);
+            if (job.cv.wait_for(lk, slice, ready)) return true;
+            if (client_hung_up(fd)) {
+                client_gone = true;
+                return false;
+            }
+        }
+    };
+    // Write the first len bytes of buf, or as many whole lines of them as
+    // the byte budget allows; false if the search has to stop
+    size_t sent = 0;
+    auto send_within_budget = [&](const string& buf, size_t len) {
+        if (max_bytes && sent + len > max_bytes) {
+            size_t room = max_bytes - sent;
+            size_t cut = room ? buf.rfind('\n', room - 1) : string::npos;
+            len = cut == string::npos ? 0 : cut + 1;
+            stats.budget_reached = true;
+        }
+        if (len > 0 && !safe_write_all(fd, buf.data(), len)) client_gone = true;
+        sent += len;
+        return !client_gone && !stats.budget_reached;
+    };
     
-    for (size_t i = 0; i < results.size(); i++) {
-        struct iovec vec;
-        vec.iov_base = const_cast<char*>(results[i].c_str());
-        vec.iov_len = results[i].size();
-        iov.push_back(vec);
-        
-        // Flush batch when full or at end
-        if (iov.size() >= MAX_IOV || i == results.size() - 1) {
-            size_t offset = 0;
-            while (offset < iov.size()) {
-                ssize_t n = writev(fd, iov.data() + offset, iov.size() - offset);
-                if (n < 0) {
-                    if (errno == EINTR) continue;
-                    // Log error to stderr (client socket might be closed)
-                    // Silently return - client disconnect is expected
-                    return;
+    if (!ordered) {
+        if (max_results) {
+            job.limited = true;
+            job.remaining = max_results;
+        }
+        content_search_pool->submit(tasks.data(), n);
+        deque<string> sending;
+        bool stopped = false;
+        while (!stopped) {
+            {
+                unique_lock<mutex> lk(job.lock);
+                if (!wait_for_job(lk, [&] { return !job.ready.empty() || job.finished == n; })) {
+                    stopped = true;
+                    break;
                 }
-                
-                // Advance offset by number of complete iovecs written
-                size_t bytes_written = n;
-                while (offset < iov.size() && bytes_written >= iov[offset].iov_len) {
-                    bytes_written -= iov[offset].iov_len;
-                    offset++;
+                if (job.ready.empty()) break;  // All batches finished and sent
+                sending.swap(job.ready);
+            }
+            for (const string& chunk : sending) {
+                if (!send_within_budget(chunk, chunk.size())) {
+                    stopped = true;
+                    break;
                 }
-                
-                // Handle partial iovec write
-                if (bytes_written > 0 && offset < iov.size()) {
-                    iov[offset].iov_base = (char*)iov[offset].iov_base + bytes_written;
-                    iov[offset].iov_len -= bytes_written;
+            }
+            sending.clear();
+        }
+        if (stopped) {
+            job.stop_queued();
+            unique_lock<mutex> lk(job.lock);
+            job.cv.wait(lk, [&] { return job.finished == n; });
+        }
+    } else {
+        job.results.resize(n);
+        job.marks.resize(n);
+        job.done.assign(n, 0);
+        size_t left = max_results ? max_results : SIZE_MAX;
+        size_t submitted = min(n, REORDER_WINDOW_BATCHES);
+        // Cancel the rest of the search and wait out the batches in flight
+        auto stop_early = [&](size_t from) {
+            job.stop_queued();
+            unique_lock<mutex> lk(job.lock);
+            job.cv.wait(lk, [&] {
+                for (size_t i = from; i < submitted; i++) {
+                    if (!job.done[i]) return false;
                 }
+                return true;
+            });
+        };
+        content_search_pool->submit(tasks.data(), submitted);
+        for (size_t b = 0; b < n; b++) {
+            bool ready;
+            {
+                unique_lock<mutex> lk(job.lock);
+                ready = wait_for_job(lk, [&] { return job.done[b] != 0; });
             }
-            iov.clear();
+            if (!ready) {
+                stop_early(b);
+                break;
+            }
+            size_t len = job.results[b].size();
+            size_t found = job.marks[b].size();
+            if (found > left) len = job.marks[b][left];
+            left -= min(found, left);
+            bool go_on = send_within_budget(job.results[b], len);
+            string().swap(job.results[b]);
+            vector<size_t>().swap(job.marks[b]);
+            
+            if (left == 0 || !go_on) {
+                stop_early(b + 1);
+                break;
+            }
+            if (submitted < n) {
+                content_search_pool->submit(&tasks[submitted], 1);
+                submitted++;
+            }
+        }
+    }
+    
+    if (client_gone && foreground) {
+        cerr << COLOR_CYAN << "[DEBUG]" << COLOR_RESET << " Client disconnected, content search cancelled\n";
+    }
+    stats.cache_hits = job.cache_hits;
+    stats.searched = job.searched;
+    return stats;
+}
+
+// Entry for a path, found through the path index (caller holds mtx)
+static const Entry* find_indexed_entry(const string& path) {
+    size_t last_slash = path.rfind('/');
+    if (last_slash == string::npos) return nullptr;
+    auto it = path_index.dir_to_entries.find(path.substr(0, last_slash));
+    if (it == path_index.dir_to_entries.end()) return nullptr;
+    for (const Entry* e : it->second) {
+        if (e->path == path) return e;
+    }
+    return nullptr;
+}
+
+static size_t metadata_result_bytes(const string& key, const vector<string>& results) {
+    size_t bytes = key.size() + sizeof(MetadataQueryResult);
+    for (const string& line : results) bytes += line.size() + sizeof(string);
+    return bytes;
+}
+
+/**
+ * Function: refresh_metadata_result
+ * Purpose: Bring a cached metadata query result up to the current index generation
+ * Parameters:
+ *   - cached: Cached result, updated in place
+ *   - matches: The query's filter for a single entry
+ * Returns: true if cached is now current; false if the journal no longer
+ *          covers its generation and only a full scan can tell
+ * Thread-safety: Caller holds mtx
+ * 
+ * Only the paths journaled since cached.generation are looked at. A cached
+ * line whose path changed stays in place if the entry still matches; changed
+ * paths that now match are appended in journal order, which is also where a
+ * full scan finds newly added entries.
+ */
+template <typename Match>
+static bool refresh_metadata_result(MetadataQueryResult& cached, const Match& matches) {
+    if (cached.generation == index_generation) return true;
+    if (cached.generation < index_journal_floor) return false;
+    
+    unordered_map<string_view, bool> changed;  // Path -> already placed
+    vector<string_view> order;
+    vector<string_view> removed_dirs;
+    auto first = partition_point(index_journal.begin(), index_journal.end(),
+                                 [&](const IndexChange& c) { return c.generation <= cached.generation; });
+    for (auto it = first; it != index_journal.end(); ++it) {
+        if (it->subtree) removed_dirs.push_back(it->path);
+        if (changed.emplace(it->path, false).second) order.push_back(it->path);
+    }
+    auto under_removed_dir = [&](string_view path) {
+        for (string_view dir : removed_dirs) {
+            if (path.size() > dir.size() && path[dir.size()] == '/' && path.starts_with(dir)) return true;
+        }
+        return false;
+    };
+    
+    vector<string> results;
+    results.reserve(cached.results.size());
+    for (string& line : cached.results) {
+        string_view path(line.data(), line.size() - 1);  // Without the '\n'
+        auto it = changed.find(path);
+        if (it != changed.end()) {
+            it->second = true;
+            const Entry* e = find_indexed_entry(string(path));
+            if (e && matches(e)) results.push_back(move(line));
+        } else if (!under_removed_dir(path)) {
+            results.push_back(move(line));
         }
     }
+    for (string_view path : order) {
+        if (changed[path]) continue;
+        const Entry* e = find_indexed_entry(string(path));
+        if (e && matches(e)) results.push_back(e->path.str() + "\n");
+    }
+    cached.results = move(results);
+    cached.generation = index_generation;
+    return true;
+}
+
+// Keep a metadata query result, evicting least recently used ones to stay
+// within METADATA_CACHE_QUERIES and METADATA_CACHE_BYTES (caller holds mtx)
+static void cache_metadata_result(string key, vector<string> results) {
+    size_t bytes = metadata_result_bytes(key, results);
+    if (bytes > METADATA_CACHE_BYTES / 4) return;  // Too large to be worth keeping
+    while (!metadata_cache.empty() && (metadata_cache.size() >= METADATA_CACHE_QUERIES ||
+                                       metadata_cache_bytes + bytes > METADATA_CACHE_BYTES)) {
+        auto lru = min_element(metadata_cache.begin(), metadata_cache.end(),
+                               [](const auto& a, const auto& b) { return a.last_used < b.last_used; });
+        metadata_cache_bytes -= lru->bytes;
+        metadata_cache.erase(lru);
+    }
+    MetadataQueryResult r;
+    r.key = move(key);
+    r.generation = index_generation;
+    r.last_used = ++metadata_cache_clock;
+    r.bytes = bytes;
+    r.results = move(results);
+    metadata_cache_bytes += bytes;
+    metadata_cache.push_back(move(r));
 }
 
 /**
@@ -2105,23 +5876,37 @@ void send_results_batched(int fd, const vector<string>& results) {
  *   1. Read name pattern length (4 bytes) + pattern data
  *   2. Read path pattern length (4 bytes) + pattern data
  *   3. Read content pattern length (4 bytes) + pattern data
- *   4. Read flags (1 byte): case_insensitive, is_regex, content_glob
+ *   4. Read flags (1 byte): case_insensitive, is_regex, content_glob, unordered,
+ *      pattern list, limits, files with matches
  *   5. Read type filter (1 byte)
  *   6. Read size operator + value (1 + 8 bytes)
  *   7. Read mtime operator + days (1 + 4 bytes)
  *   8. Read context lines: before_ctx, after_ctx (1 + 1 bytes)
+ *   9. If flag bit 4 (pattern list) is set: pattern count (4 bytes), then
+ *      per pattern its length (4 bytes) + data; content pattern is empty
+ *  10. If flag bit 5 (limits) is set: max results, max matches per file
+ *      (4 + 4 bytes, 0 = unlimited)
+ * 
+ * Response: one result per line, optionally followed by status lines that
+ * start with '!' (e.g. "!incomplete ..." while the index is still loading).
  */
 void handle_client(int fd) {
     // Use RAII to ensure fd is always closed for this client connection
     ScopedFd scoped_fd(fd);
     
-    // Connection count was incremented in the accept loop before calling this function
-    // It will be decremented by the spawning lambda after this function returns
-    // (see the accept loop around line 2993)
+    // Connection count was incremented in accept_clients() before calling this function
+    // It will be decremented by the spawning lambda in run_event_loop() after this
+    // function returns
     
     // SECURITY: Maximum pattern size to prevent memory exhaustion attacks
     constexpr uint32_t MAX_PATTERN_SIZE = 1024 * 1024;  // 1MB limit
     
+    // A client that stops reading fails the next write after this long, so
+    // it cannot hold mtx and the search workers indefinitely
+    struct timeval send_timeout {};
+    send_timeout.tv_sec = CLIENT_SEND_TIMEOUT_SEC;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+    
     uint32_t net_nlen, net_plen, net_clen;
     
     // Read name pattern length and validate
@@ -2172,6 +5957,11 @@ void handle_client(int fd) {
     bool case_ins = flags & 1;      // bit 0 (value 1)
     bool is_regex = flags & 2;      // bit 1 (value 2)
     bool content_glob = flags & 4;  // bit 2 (value 4)
+    bool unordered = flags & 8;     // bit 3 (value 8): stream content results as found
+    bool multi = flags & 16;        // bit 4 (value 16): pattern list follows the context bytes
+    bool limits = flags & 32;       // bit 5 (value 32): result limits follow the pattern list
+    bool files_only = flags & 64;   // bit 6 (value 64): one line per matching file
+    bool budgets = flags & 128;     // bit 7 (value 128): query budgets follow the limits
 
     // Read type filter
     uint8_t type_filter = 0;
@@ -2206,11 +5996,73 @@ void handle_client(int fd) {
     if (read(fd, &before_ctx, 1) != 1) before_ctx = 0;
     if (read(fd, &after_ctx, 1) != 1) after_ctx = 0;
 
-    bool has_content = !content_pat.empty();
+    // Read the pattern list of a multi-pattern search (-e/-f)
+    // SECURITY: Count and total size are bounded like a single pattern
+    shared_ptr<MultiPattern> multi_pat;
+    if (multi) {
+        constexpr uint32_t MAX_PATTERN_COUNT = 65536;
+        uint32_t net_count;
+        if (!safe_read_all(fd, &net_count, 4)) { return; }
+        uint32_t count = ntohl(net_count);
+        if (count == 0 || count > MAX_PATTERN_COUNT || !content_pat.empty() || content_glob) {
+            const char* err = "Invalid pattern list\n";
+            safe_write_all(fd, err, strlen(err));
+            return;
+        }
+        multi_pat = make_shared<MultiPattern>();
+        multi_pat->is_regex = is_regex;
+        size_t total = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t net_len;
+            if (!safe_read_all(fd, &net_len, 4)) { return; }
+            uint32_t len = ntohl(net_len);
+            total += len;
+            if (total > MAX_PATTERN_SIZE) {
+                const char* err = "Pattern list too large\n";
+                safe_write_all(fd, err, strlen(err));
+                return;
+            }
+            string pat(len, '\0');
+            if (len > 0 && !safe_read_all(fd, pat.data(), len)) { return; }
+            multi_pat->patterns.push_back(move(pat));
+        }
+        string err = compile_multi_pattern(*multi_pat, case_ins);
+        if (!err.empty()) {
+            safe_write_all(fd, err.data(), err.size());
+            return;
+        }
+    }
+
+    // Read result limits: total matches (or paths) and matches per file,
+    // 0 = unlimited
+    size_t max_results = 0, max_count = 0;
+    if (limits) {
+        uint32_t net_limits[2];
+        if (!safe_read_all(fd, net_limits, sizeof(net_limits))) { return; }
+        max_results = ntohl(net_limits[0]);
+        max_count = ntohl(net_limits[1]);
+    }
+
+    // Read query budgets: deadline in ms, result bytes and files searched,
+    // 0 = unlimited. The deadline runs from here, so time spent waiting for
+    // the index lock counts against it.
+    uint32_t deadline_ms = 0;
+    size_t max_bytes = 0, max_files = 0;
+    if (budgets) {
+        uint32_t net_budgets[3];
+        if (!safe_read_all(fd, net_budgets, sizeof(net_budgets))) { return; }
+        deadline_ms = ntohl(net_budgets[0]);
+        max_bytes = ntohl(net_budgets[1]);
+        max_files = ntohl(net_budgets[2]);
+    }
+    auto deadline = deadline_ms ? chrono::steady_clock::now() + chrono::milliseconds(deadline_ms)
+                                : chrono::steady_clock::time_point::max();
+
+    bool has_content = !content_pat.empty() || multi;
 
     // Compile regex if needed
     shared_ptr<RE2> re;  // Use shared_ptr for thread-safe lifetime management
-    if (has_content && is_regex) {
+    if (has_content && is_regex && !multi) {
         RE2::Options opts;
         opts.set_case_sensitive(!case_ins);
         re = make_shared<RE2>(content_pat, opts);
@@ -2221,6 +6073,31 @@ void handle_client(int fd) {
         }
     }
 
+    // Content globs run as byte-wise regexes anchored to the line, which get
+    // the literal prefilter and match in place. The multi-line form (no
+    // pattern element can cross a '\n') finds matching lines in one DFA pass
+    // over the whole buffer. fnmatch() per line remains the fallback for
+    // globs that do not translate exactly.
+    shared_ptr<RE2> buffer_re;
+    if (has_content && content_glob) {
+        string glob_re;
+        if (glob_to_regex(content_pat, case_ins, glob_re)) {
+            RE2::Options opts;
+            opts.set_encoding(RE2::Options::EncodingLatin1);
+            opts.set_case_sensitive(!case_ins);
+            opts.set_log_errors(false);
+            opts.set_never_nl(true);
+            auto compiled = make_shared<RE2>("\\A(?:" + glob_re + ")\\z", opts);
+            auto whole = make_shared<RE2>("(?m)^(?:" + glob_re + ")$", opts);
+            if (compiled->ok() && whole->ok()) {
+                re = compiled;
+                buffer_re = whole;
+                is_regex = true;
+                content_glob = false;
+            }
+        }
+    }
+
     int fnm_flags = case_ins ? FNM_CASEFOLD : 0;
 
     // PERFORMANCE OPTIMIZATION: Path index analysis
@@ -2268,8 +6145,120 @@ void handle_client(int fd) {
         }
     }
 
-    lock_guard<mutex> lk(mtx);
-
+    lock_guard<mutex> lk(mtx);
+
+    // While the database is still loading, answer from the entries published
+    // so far; the path index is only built once loading completes
+    bool partial = !index_complete;
+    if (partial) can_use_index = false;
+
+    // Why a query budget cut the results short, empty if none did
+    string truncated;
+    // Send path results, as many whole lines as the byte budget allows
+    auto send_paths = [&](const vector<string>& results) {
+        size_t fit = results.size();
+        if (max_bytes) {
+            size_t bytes = 0;
+            for (fit = 0; fit < results.size() && bytes + results[fit].size() <= max_bytes; fit++) {
+                bytes += results[fit].size();
+            }
+        }
+        if (fit == results.size()) {
+            if (!results.empty()) send_results_batched(fd, results);
+            return;
+        }
+        truncated = "result budget of " + to_string(max_bytes) + " bytes reached";
+        if (fit > 0) send_results_batched(fd, vector<string>(results.begin(), results.begin() + fit));
+    };
+    // Status lines start with '!', which no result line can (paths are absolute)
+    auto send_status_lines = [&]() {
+        if (!truncated.empty()) {
+            string note = "!truncated " + truncated + "\n";
+            safe_write_all(fd, note.data(), note.size());
+        }
+        if (partial) {
+            string note = "!incomplete index still loading, searched " + to_string(entries.size()) + " entries\n";
+            safe_write_all(fd, note.data(), note.size());
+        }
+    };
+
+    // Filter for a single entry (type, size, mtime, name and path patterns)
+    auto entry_matches = [&](const Entry* e) -> bool {
+        bool type_match = (type_filter == 0) ||
+                          (type_filter == 1 && !e->is_dir) ||
+                          (type_filter == 2 && e->is_dir);
+        if (!type_match) return false;
+        if (e->is_dir && has_content) return false;
+
+        if (size_op) {
+            bool match = false;
+            if (size_op == 1) match = e->size < size_val;
+            else if (size_op == 2) match = e->size == size_val;
+            else if (size_op == 3) match = e->size > size_val;
+            if (!match) return false;
+        }
+
+        if (mtime_op) {
+            time_t now = time(nullptr);
+            int32_t days_old = (now - e->mtime) / 86400;
+            bool match = false;
+            if (mtime_op == 1) match = days_old < mtime_days;
+            else if (mtime_op == 2) match = days_old == mtime_days;
+            else if (mtime_op == 3) match = days_old > mtime_days;
+            if (!match) return false;
+        }
+
+        // Calculate relative path from entry's own root
+        string rel;
+        if (e->root_index < root_paths.size()) {
+            rel = e->path.substr(root_paths[e->root_index].size());
+        } else {
+            rel = e->path; // Fallback if root_index is invalid
+        }
+
+        size_t pos = e->path.rfind('/');
+        string_view base = (pos == string::npos) ? string_view(e->path) : string_view(e->path.data() + pos + 1);
+
+        bool name_match = fnmatch(name_pat.c_str(), base.data(), fnm_flags) == 0;
+        bool path_match = path_pat.empty() || fnmatch(path_pat.c_str(), rel.c_str(), fnm_flags) == 0;
+
+        return name_match && path_match;
+    };
+
+    // Identical metadata queries are answered from metadata_cache, brought up
+    // to date from the change journal. -mtime results depend on the current
+    // time and are never cached; limited queries stop scanning early instead.
+    bool cacheable = !has_content && !mtime_op && !partial && !max_results;
+    string cache_key;
+    if (cacheable) {
+        cache_key.push_back(static_cast<char>(case_ins));
+        cache_key.push_back(static_cast<char>(type_filter));
+        cache_key.push_back(static_cast<char>(size_op));
+        cache_key.append(reinterpret_cast<const char*>(&size_val), sizeof(size_val));
+        cache_key.append(to_string(name_pat.size())).append(1, ':').append(name_pat).append(path_pat);
+        auto it = find_if(metadata_cache.begin(), metadata_cache.end(),
+                          [&](const MetadataQueryResult& r) { return r.key == cache_key; });
+        if (it != metadata_cache.end()) {
+            uint64_t cached_generation = it->generation;
+            if (refresh_metadata_result(*it, entry_matches)) {
+                metadata_cache_bytes -= it->bytes;
+                it->bytes = metadata_result_bytes(it->key, it->results);
+                metadata_cache_bytes += it->bytes;
+                it->last_used = ++metadata_cache_clock;
+                if (foreground) {
+                    cerr << COLOR_CYAN << "[DEBUG]" << COLOR_RESET << " Query cache hit: "
+                         << it->results.size() << " results, "
+                         << (index_generation - cached_generation) << " index changes applied\n";
+                }
+                send_paths(it->results);
+                send_status_lines();
+                return;
+            }
+            metadata_cache_bytes -= it->bytes;
+            metadata_cache.erase(it);
+        }
+    }
+
     // Collect candidate entries using path index if possible
     vector<const Entry*> candidates_from_index;
     
@@ -2320,80 +6309,63 @@ void handle_client(int fd) {
 
     vector<const Entry*> candidates;
     vector<string> path_results;  // Collect results for batched sending
+    size_t path_bytes = 0;
     if (!has_content) {
         path_results.reserve(1000);  // Pre-allocate for efficiency
     }
     
     // Lambda to filter and process a single entry (reduces code duplication)
     auto process_entry = [&](const Entry* e) {
-        bool type_match = (type_filter == 0) ||
-                          (type_filter == 1 && !e->is_dir) ||
-                          (type_filter == 2 && e->is_dir);
-        if (!type_match) return;
-        if (e->is_dir && has_content) return;
-
-        if (size_op) {
-            bool match = false;
-            if (size_op == 1) match = e->size < size_val;
-            else if (size_op == 2) match = e->size == size_val;
-            else if (size_op == 3) match = e->size > size_val;
-            if (!match) return;
-        }
-
-        if (mtime_op) {
-            time_t now = time(nullptr);
-            int32_t days_old = (now - e->mtime) / 86400;
-            bool match = false;
-            if (mtime_op == 1) match = days_old < mtime_days;
-            else if (mtime_op == 2) match = days_old == mtime_days;
-            else if (mtime_op == 3) match = days_old > mtime_days;
-            if (!match) return;
-        }
-
-        // Calculate relative path from entry's own root
-        string rel;
-        if (e->root_index < root_paths.size()) {
-            rel = e->path.substr(root_paths[e->root_index].size());
+        if (!entry_matches(e)) return;
+        if (!has_content) {
+            path_results.push_back(e->path.str() + "\n");
+            path_bytes += path_results.back().size();
         } else {
-            rel = e->path; // Fallback if root_index is invalid
-        }
-
-        size_t pos = e->path.rfind('/');
-        string_view base = (pos == string::npos) ? string_view(e->path) : string_view(e->path.data() + pos + 1);
-
-        bool name_match = fnmatch(name_pat.c_str(), base.data(), fnm_flags) == 0;
-        bool path_match = path_pat.empty() || fnmatch(path_pat.c_str(), rel.c_str(), fnm_flags) == 0;
-
-        if (name_match && path_match) {
-            if (!has_content) {
-                path_results.push_back(e->path + "\n");
-            } else {
-                candidates.push_back(e);
-            }
+            candidates.push_back(e);
         }
     };
     
     // Determine which entry set to iterate over
     bool use_index_results = can_use_index && !index_prefix.empty() && !candidates_from_index.empty();
     
+    // Path results stop at the limit, or once they exceed the byte budget;
+    // content candidates are all collected. Both give up at the deadline,
+    // which is checked every 1024 entries.
+    size_t path_limit = max_results && !has_content ? max_results : SIZE_MAX;
+    size_t examined = 0;
+    bool out_of_time = false;
+    auto keep_scanning = [&]() {
+        if (path_results.size() >= path_limit || (max_bytes && path_bytes > max_bytes)) return false;
+        if ((++examined & 1023) == 0 && chrono::steady_clock::now() >= deadline) {
+            out_of_time = true;
+            return false;
+        }
+        return true;
+    };
     if (use_index_results) {
         // Iterate over indexed candidates only
         for (const auto* e : candidates_from_index) {
+            if (!keep_scanning()) break;
             process_entry(e);
         }
     } else {
         // Fall back to full scan of all entries
         for (const auto& e : entries) {
+            if (!keep_scanning()) break;
             process_entry(&e);
         }
     }
     
     // Send all path results in batches
-    if (!path_results.empty()) {
-        send_results_batched(fd, path_results);
+    send_paths(path_results);
+    if (out_of_time) {
+        size_t total = use_index_results ? candidates_from_index.size() : entries.size();
+        truncated = "deadline of " + to_string(deadline_ms) + " ms reached, examined " + to_string(examined) +
+                    " of " + to_string(total) + " entries";
     }
+    if (cacheable && truncated.empty()) cache_metadata_result(move(cache_key), move(path_results));
 
-    if (has_content) {
+    if (has_content && !out_of_time) {
         // Ensure thread pool is initialized
         if (!content_search_pool) {
             const char* err = "Internal error: thread pool not initialized\n";
@@ -2401,216 +6373,318 @@ void handle_client(int fd) {
             return;
         }
         
-        // Prepare for parallel content search
-        vector<future<vector<string>>> futures;
-        futures.reserve(candidates.size());
+        ContentQuery q;
+        q.pattern = content_pat;
+        q.case_ins = case_ins;
+        q.is_regex = is_regex;
+        q.content_glob = content_glob;
+        q.before_ctx = before_ctx;
+        q.after_ctx = after_ctx;
+        q.re = re;
+        q.multi = multi_pat;
+        if (re) q.prefilter = build_regex_prefilter(re->pattern(), re->options());
+        if (!q.prefilter.active()) q.buffer_re = buffer_re;
+        if (!is_regex && !content_glob && !multi) q.literal = LiteralMatcher(content_pat, case_ins);
+        q.files_only = files_only;
+        // A file never contributes more than the total limit
+        q.max_count = max_count;
+        if (max_results && (!max_count || max_results < max_count)) q.max_count = max_results;
+        
+        // Everything that shapes the result lines, except the output order
+        string cache_key;
+        cache_key.push_back(static_cast<char>(flags & ~(8 | 32 | 128)));
+        cache_key.push_back(static_cast<char>(before_ctx));
+        cache_key.push_back(static_cast<char>(after_ctx));
+        auto add_key_part = [&](const string& part) {
+            cache_key.append(to_string(part.size())).append(1, ':').append(part);
+        };
+        add_key_part(content_pat);
+        add_key_part(to_string(q.max_count));
+        if (multi_pat) {
+            for (const string& pat : multi_pat->patterns) add_key_part(pat);
+        }
+        q.cache = content_cache_slot(cache_key);
         
-        // Submit file processing tasks to thread pool
-        for (const auto* ep : candidates) {
-            // Capture necessary variables by value for thread safety
-            string path = ep->path;  // Copy path string
+        // The file budget keeps the first candidates, in index order
+        size_t total = candidates.size();
+        if (max_files && candidates.size() > max_files) candidates.resize(max_files);
+        ContentSearchStats stats = run_content_search(fd, q, candidates, !unordered, max_results,
+                                                      deadline, max_bytes);
+        if (foreground && stats.cache_hits > 0) {
+            cerr << COLOR_CYAN << "[DEBUG]" << COLOR_RESET << " Content cache answered " << stats.cache_hits
+                 << " of " << candidates.size() << " files\n";
+        }
+        if (stats.deadline_reached) {
+            truncated = "deadline of " + to_string(deadline_ms) + " ms reached";
+        } else if (stats.budget_reached) {
+            truncated = "result budget of " + to_string(max_bytes) + " bytes reached";
+        } else if (candidates.size() < total && stats.searched == candidates.size()) {
+            truncated = "file budget of " + to_string(max_files) + " reached";
+        }
+        if (!truncated.empty()) {
+            truncated += ", searched " + to_string(stats.searched) + " of " + to_string(total) + " files";
+        }
+    }
+
+    send_status_lines();
+    
+    // ScopedFd will automatically close fd when function returns
+}
+
+// Consume the 8-byte counter of a readable eventfd/timerfd
+static void drain_counter_fd(int fd) {
+    uint64_t value = 0;
+    ssize_t n = read(fd, &value, sizeof(value));
+    (void)n;  // EAGAIN just means another wakeup already drained it
+}
+
+/**
+ * Function: accept_clients
+ * Purpose: Accept all pending connections on the (non-blocking) listening socket
+ * Parameters:
+ *   - srv: Listening socket file descriptor
+ * Returns: void
+ * Security:
+ *   - Enforces MAX_CONCURRENT_CLIENTS before any per-client resources are used
+ * Thread-safety: Event loop thread only
+ * 
+ * Accepted sockets are registered with epoll (EPOLLONESHOT) instead of getting
+ * a thread right away; run_event_loop() dispatches handle_client() once the
+ * request bytes have arrived, so idle connections don't pin a thread.
+ */
+void accept_clients(int srv) {
+    while (true) {
+        int c = accept4(srv, nullptr, nullptr, SOCK_CLOEXEC);
+        if (c < 0) {
+            // Save errno immediately after accept() fails
+            int saved_errno = errno;
+            if (saved_errno == EINTR) continue;
+            if (saved_errno == EAGAIN || saved_errno == EWOULDBLOCK) return;  // Backlog drained
+            // Connection aborted before we got to it - try the next one
+            if (saved_errno == ECONNABORTED) continue;
             
-            // REVIEWER_NOTE: This lambda runs in a worker thread from the pool.
-            // It must capture everything by value to avoid use-after-free.
-            // The shared_ptr<RE2> is safely copied (refcount increment).
-            //
-            // Content Search Algorithm:
-            // 1. Memory-map the file for zero-copy access
-            // 2. Check for binary data in first 1KB (skip binary files)
-            // 3. If no context: Scan line-by-line with in-place pattern matching
-            // 4. If context requested: Parse all lines, find matches, emit with context
-            //
-            // Pattern Matching Methods:
-            // - Fixed string (case-insensitive): strcasestr() or memmem()
-            // - Fixed string (case-sensitive): memmem() for efficiency
-            // - Regex: RE2::PartialMatch() (thread-safe)
-            // - Glob: fnmatch() with FNM_CASEFOLD for case-insensitive
-            //
-            // SECURITY: File is mapped read-only with MAP_PRIVATE
-            // PERFORMANCE: Zero-copy via mmap, memmem for fixed strings
-            futures.push_back(content_search_pool->enqueue([path, content_pat, case_ins, 
-                                                            is_regex, content_glob, 
-                                                            before_ctx, after_ctx, re]() {  // Capture re by value
-                vector<string> file_results;
-                
-                // Each thread gets its own file mapping for thread safety
-                MappedFile file(path);
-                if (!file.is_valid()) return file_results;
-                
-                // SECURITY: Binary file detection - scan first 1KB for null bytes
-                // This prevents displaying binary files as text (can cause terminal corruption)
-                size_t check = min<size_t>(1024, file.size);
-                bool binary = false;
-                for (size_t i = 0; i < check; i++) {
-                    if (file.data[i] == '\0') {
-                        binary = true;
-                        break;
-                    }
-                }
-                if (binary) return file_results;  // Skip binary files
-                
-                if (before_ctx == 0 && after_ctx == 0) {
-                    // Fast path: No context lines requested
-                    // Scan file using mmap, no intermediate allocations
-                    const char* line_start = file.data;
-                    size_t lineno = 1;
-                    
-                    for (size_t i = 0; i < file.size; i++) {
-                        if (file.data[i] == '\n') {
-                            size_t line_len = file.data + i - line_start;
-                            
-                            // Match pattern in-place (no string allocation unless needed)
-                            bool match = false;
-                            if (content_glob) {
-                                string line_str(line_start, line_len);
-                                int fnm_flags_content = case_ins ? FNM_CASEFOLD : 0;
-                                match = fnmatch(content_pat.c_str(), line_str.c_str(), fnm_flags_content) == 0;
-                            } else if (is_regex) {
-                                re2::StringPiece line_piece(line_start, line_len);
-                                match = RE2::PartialMatch(line_piece, *re);
-                            } else if (case_ins) {
-                                // Use strcasestr with temporary null-terminated string
-                                string line_str(line_start, line_len);
-                                match = strcasestr(line_str.c_str(), content_pat.c_str()) != nullptr;
-                            } else {
-                                // Simple substring search using memmem
-                                match = (memmem(line_start, line_len, 
-                                              content_pat.c_str(), content_pat.size()) != nullptr);
-                            }
-                            
-                            if (match) {
-                                string out = path + ":" + to_string(lineno) + ":" +
-                                           string(line_start, line_len) + "\n";
-                                file_results.push_back(out);
-                            }
-                            
-                            line_start = file.data + i + 1;
-                            lineno++;
-                        }
-                    }
-                    
-                    // Handle last line if file doesn't end with newline
-                    if (line_start < file.data + file.size) {
-                        size_t line_len = file.data + file.size - line_start;
-                        bool match = false;
-                        if (content_glob) {
-                            string line_str(line_start, line_len);
-                            int fnm_flags_content = case_ins ? FNM_CASEFOLD : 0;
-                            match = fnmatch(content_pat.c_str(), line_str.c_str(), fnm_flags_content) == 0;
-                        } else if (is_regex) {
-                            re2::StringPiece line_piece(line_start, line_len);
-                            match = RE2::PartialMatch(line_piece, *re);
-                        } else if (case_ins) {
-                            string line_str(line_start, line_len);
-                            match = strcasestr(line_str.c_str(), content_pat.c_str()) != nullptr;
-                        } else {
-                            match = (memmem(line_start, line_len,
-                                          content_pat.c_str(), content_pat.size()) != nullptr);
-                        }
-                        if (match) {
-                            string out = path + ":" + to_string(lineno) + ":" +
-                                       string(line_start, line_len) + "\n";
-                            file_results.push_back(out);
-                        }
-                    }
-                } else {
-                    // With context lines - parse all lines first
-                    vector<pair<size_t, string>> all_lines; // lineno, content
-                    const char* line_start = file.data;
-                    size_t lineno = 1;
-                    
-                    for (size_t i = 0; i < file.size; i++) {
-                        if (file.data[i] == '\n') {
-                            size_t line_len = file.data + i - line_start;
-                            all_lines.emplace_back(lineno, string(line_start, line_len));
-                            line_start = file.data + i + 1;
-                            lineno++;
-                        }
-                    }
-                    
-                    // Handle last line if file doesn't end with newline
-                    if (line_start < file.data + file.size) {
-                        size_t line_len = file.data + file.size - line_start;
-                        all_lines.emplace_back(lineno, string(line_start, line_len));
-                    }
-                    
-                    // Find all matching line indices and store in a set for O(1) lookup
-                    vector<size_t> match_indices;
-                    unordered_set<size_t> match_set;
-                    for (size_t i = 0; i < all_lines.size(); ++i) {
-                        bool match = false;
-                        const string& content = all_lines[i].second;
-                        if (content_glob) {
-                            int fnm_flags_content = case_ins ? FNM_CASEFOLD : 0;
-                            match = fnmatch(content_pat.c_str(), content.c_str(), fnm_flags_content) == 0;
-                        } else if (is_regex) {
-                            match = RE2::PartialMatch(content, *re);
-                        } else if (case_ins) {
-                            match = strcasestr(content.c_str(), content_pat.c_str()) != nullptr;
-                        } else {
-                            match = content.find(content_pat) != string::npos;
-                        }
-                        if (match) {
-                            match_indices.push_back(i);
-                            match_set.insert(i);
-                        }
-                    }
-                    
-                    // Process matches with context, merging overlapping ranges
-                    if (!match_indices.empty()) {
-                        vector<pair<size_t, size_t>> ranges; // start, end (inclusive)
-                        
-                        for (size_t match_idx : match_indices) {
-                            size_t start = (match_idx >= before_ctx) ? match_idx - before_ctx : 0;
-                            size_t end = min(match_idx + after_ctx, all_lines.size() - 1);
-                            
-                            // Merge with previous range if overlapping
-                            if (!ranges.empty() && start <= ranges.back().second + 1) {
-                                ranges.back().second = max(ranges.back().second, end);
-                            } else {
-                                ranges.emplace_back(start, end);
-                            }
-                        }
-                        
-                        // Collect all context output
-                        for (size_t r = 0; r < ranges.size(); ++r) {
-                            if (r > 0) {
-                                file_results.push_back("--\n");
-                            }
-                            
-                            for (size_t i = ranges[r].first; i <= ranges[r].second; ++i) {
-                                bool is_match = match_set.count(i) > 0;
-                                char separator = is_match ? ':' : '-';
-                                
-                                string out = path + ":" + to_string(all_lines[i].first) + separator + all_lines[i].second + "\n";
-                                file_results.push_back(out);
-                            }
-                        }
-                    }
-                }
-                
-                return file_results;
-            }));
+            if (foreground) {
+                cerr << COLOR_YELLOW << "[WARN]" << COLOR_RESET
+                     << " accept() failed: " << strerror(saved_errno) << "\n";
+            }
+            return;
         }
         
-        // Collect results from all worker threads
-        for (auto& future : futures) {
-            try {
-                vector<string> file_results = future.get();
-                if (!file_results.empty()) {
-                    send_results_batched(fd, file_results);
-                }
-            } catch (const exception& e) {
-                // Log error but continue with other files
-                if (foreground) {
-                    cerr << COLOR_YELLOW << "[WARNING]" << COLOR_RESET 
-                         << " Worker thread error: " << e.what() << "\n";
-                }
+        // Atomically check and increment connection counter
+        // Use fetch_add to increment, then check if we exceeded the limit
+        int previous_count = active_connections.fetch_add(1);
+        
+        if (previous_count >= MAX_CONCURRENT_CLIENTS) {
+            // Connection limit was already reached - reject and rollback
+            active_connections.fetch_sub(1);  // Rollback the increment
+            
+            if (foreground) {
+                cerr << COLOR_YELLOW << "[WARN]" << COLOR_RESET 
+                     << " Connection limit reached (" << MAX_CONCURRENT_CLIENTS 
+                     << "), rejecting connection\n";
+            }
+            const char* err = "Server busy: too many concurrent connections\n";
+            safe_write_all(c, err, strlen(err));
+            close(c);
+            continue;
+        }
+        
+        struct epoll_event ev {};
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.fd = c;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c, &ev) < 0) {
+            active_connections.fetch_sub(1);
+            close(c);
+        }
+    }
+}
+
+/**
+ * Function: start_db_loader
+ * Purpose: Load the persisted index in the background while clients are served
+ * Parameters:
+ *   - from_snapshot: entries were already mapped by load_index_snapshot();
+ *     only its arena check and path index are left (SQLite rows otherwise)
+ * Returns: true if the loader thread was started, false if the caller
+ *          should load synchronously
+ * Thread-safety: Main thread, before init_event_loop()
+ *
+ * Queries issued while index_complete is false scan the entries published
+ * so far and end with a "!incomplete" status line. The loader thread also
+ * runs the steps main() performs after a synchronous load (journal replay,
+ * reconciliation and the path index), so the event loop keeps serving
+ * clients meanwhile. Inotify is not read until finish_db_load(), so events
+ * queue in the kernel.
+ */
+bool start_db_loader(bool from_snapshot) {
+    loader_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loader_efd < 0) return false;
+
+    index_complete = false;
+    db_loader = thread([from_snapshot]() {
+        if (!from_snapshot || !verify_index_snapshot()) load_entries_from_db();
+        if (running) {
+            replay_journal(true);
+            if (foreground) {
+                cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET
+                     << " Reconciling database with filesystem...\n";
+            }
+            reconcile_db_with_filesystem();
+            lock_guard<mutex> lk(mtx);
+            if (running && !path_index_valid) {
+                build_path_index();
+                path_index_valid = true;
             }
         }
+        uint64_t one = 1;
+        ignore_write_result(write(loader_efd, &one, sizeof(one)));
+    });
+    return true;
+}
+
+/**
+ * Function: finish_db_load
+ * Purpose: Start watching an index the loader thread has brought up to date
+ * Parameters: None
+ * Returns: void
+ * Thread-safety: Event loop thread only (on loader_efd)
+ *
+ * Only flips index_complete, adds in_fd to epoll and starts the persistence
+ * writers; the loading itself happened on db_loader.
+ */
+void finish_db_load() {
+    if (db_loader.joinable()) db_loader.join();
+    if (!running) return;  // Load was cut short by shutdown
+
+    {
+        lock_guard<mutex> lk(mtx);
+        index_complete = true;
+    }
+
+    struct epoll_event ev {};
+    ev.events = EPOLLIN;
+    ev.data.fd = in_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, in_fd, &ev);
+    start_journal_writer();
+    start_db_writer();
+
+    if (foreground) {
+        cerr << COLOR_GREEN << "[INFO]" << COLOR_RESET
+             << " Index load complete: " << entries.size() << " entries\n";
     }
+}
+
+/**
+ * Function: init_event_loop
+ * Purpose: Create the epoll instance and register every event source
+ * Parameters:
+ *   - srv: Listening socket file descriptor (must be non-blocking)
+ * Returns: true on success, false on error
+ * Thread-safety: Must be called from main thread before run_event_loop()
+ * 
+ * Event sources:
+ * - in_fd:        inotify events
+ * - srv:          new client connections
+ * - shutdown_efd: written by sig_handler (created earlier in main)
+ * - cleanup_tfd:  pending move expiry (armed only while moves are pending)
+ * - flush_tfd:    periodic database flush (armed only with --db)
+ * - loader_efd:   background database load finished (see start_db_loader)
+ */
+bool init_event_loop(int srv) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) return false;
     
-    // ScopedFd will automatically close fd when function returns
+    cleanup_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (cleanup_tfd < 0) return false;
+    
+    if (db_enabled) {
+        flush_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (flush_tfd < 0) return false;
+        set_timer(flush_tfd, FLUSH_INTERVAL_SEC);
+    }
+    
+    for (int fd : {in_fd, srv, shutdown_efd, cleanup_tfd, flush_tfd, loader_efd}) {
+        if (fd < 0) continue;
+        if (fd == in_fd && !index_complete) continue;  // Added by finish_db_load()
+        struct epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
+    }
+    return true;
+}
+
+/**
+ * Function: run_event_loop
+ * Purpose: Single epoll reactor for the daemon's main thread
+ * Parameters:
+ *   - srv: Listening socket file descriptor
+ * Returns: void (runs until shutdown is signalled through shutdown_efd)
+ * Thread-safety: Main thread only; owns inotify, watches and timers
+ * 
+ * The loop blocks in epoll_wait() without a timeout: there are no idle
+ * wakeups, and an inotify event is applied to the index as soon as the
+ * kernel queues it. Periodic work is driven by timerfds instead of
+ * polling the clock, and shutdown by an eventfd instead of polling 'running'.
+ * 
+ * REVIEWER_NOTE: Client fds are removed from epoll before handle_client()
+ * takes ownership of them, so the reactor never touches a closed fd.
+ */
+void run_event_loop(int srv) {
+    constexpr int MAX_EVENTS = 64;
+    struct epoll_event events[MAX_EVENTS];
+    
+    while (running) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;  // Interrupted by signal, check running flag
+            if (foreground) {
+                cerr << COLOR_RED << "[ERROR]" << COLOR_RESET 
+                     << " epoll_wait() failed: " << strerror(errno) << "\n";
+            }
+            break;
+        }
+        
+        bool had_fs_events = false;
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == in_fd) {
+                process_events();
+                had_fs_events = true;
+            } else if (fd == srv) {
+                accept_clients(srv);
+            } else if (fd == shutdown_efd) {
+                drain_counter_fd(shutdown_efd);
+                running = 0;
+            } else if (fd == cleanup_tfd) {
+                drain_counter_fd(cleanup_tfd);
+                cleanup_stale_pending_moves();
+                lock_guard<mutex> lk(pending_moves_mtx);
+                if (pending_moves.empty()) set_timer(cleanup_tfd, 0);
+            } else if (fd == flush_tfd) {
+                drain_counter_fd(flush_tfd);
+                // An up-to-date database may still be ahead of the snapshot
+                if (db_dirty || static_cast<int64_t>(db_generation.load()) != snapshot_generation) {
+                    request_db_flush();
+                }
+            } else if (fd == loader_efd) {
+                drain_counter_fd(loader_efd);
+                finish_db_load();
+            } else {
+                // Client request is ready - hand the connection to a handler thread
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+                // Connection counter was incremented in accept_clients()
+                thread([fd]() {
+                    handle_client(fd);
+                    // Decrement connection counter when handler completes
+                    active_connections.fetch_sub(1);
+                }).detach();
+            }
+        }
+        
+        // Flush early once enough changes have accumulated
+        if (had_fs_events) maybe_flush_to_db();
+    }
 }
 
 // Helper functions for root path validation
@@ -2659,7 +6733,7 @@ vector<string> deduplicate_paths(const vector<string>& paths) {
  * 8. Initialize inotify for filesystem monitoring
  * 9. Initialize thread pool for content search
  * 10. Index all root directories recursively
- * 11. Enter main event loop (accept clients + process inotify)
+ * 11. Enter epoll event loop (accept clients, inotify, timers, shutdown)
  * 
  * Security Model:
  * - Runs as unprivileged user (never requires root)
@@ -2732,6 +6806,7 @@ int main(int argc, char** argv) {
     
     // Set global foreground flag
     foreground = fg;
+    use_io_uring = cfg.io_uring;
     
     // Log which config was loaded if in foreground mode
     if (cfg.loaded && foreground) {
@@ -2812,6 +6887,15 @@ int main(int argc, char** argv) {
     
     // Initialize database if --db was provided
     vector<string> db_roots;  // Track if entries were loaded from DB
+    bool background_load = false;  // Rows still loading; finish_db_load() completes startup
+    // Stop and join db_loader on every return from main(): destroying a
+    // joinable std::thread calls std::terminate
+    struct LoaderJoin {
+        ~LoaderJoin() {
+            running = 0;
+            if (db_loader.joinable()) db_loader.join();
+        }
+    } loader_join;
     if (!db_arg.empty()) {
         db_enabled = true;
         db_path = db_arg;
@@ -2838,10 +6922,16 @@ int main(int argc, char** argv) {
         // Save current roots
         save_roots_to_db(canonical_roots);
         
-        // Load existing entries from DB if available
+        // Load existing entries, preferring the mapped snapshot over SQLite rows,
+        // then apply changes journaled after the last flush. Rows (or the rest
+        // of a snapshot restore) are loaded in the background while queries are
+        // served (see start_db_loader).
         if (!db_roots.empty()) {
-            load_entries_from_db();
+            bool from_snapshot = load_index_snapshot();
+            background_load = start_db_loader(from_snapshot);
+            if (!background_load && (!from_snapshot || !verify_index_snapshot())) load_entries_from_db();
         }
+        if (!background_load) replay_journal(!db_roots.empty());
         
         // Initialize flush timer
         last_flush_time = chrono::steady_clock::now();
@@ -2853,10 +6943,22 @@ int main(int argc, char** argv) {
              << COLOR_RESET << "\n";
     }
 
+    // Create the shutdown eventfd before installing handlers so a signal can
+    // always wake the event loop
+    shutdown_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (shutdown_efd < 0) {
+        cerr << COLOR_RED << "ERROR: eventfd failed: " << strerror(errno) << COLOR_RESET << "\n";
+        cleanup_pid_file();
+        return 1;
+    }
+
     signal(SIGINT, sig_handler);
     signal(SIGTERM, sig_handler);
     signal(SIGQUIT, sig_handler);
     signal(SIGHUP, sig_handler);
+    // A client that disconnects mid-stream must fail the write with EPIPE
+    // (and cancel its search) instead of killing the daemon
+    signal(SIGPIPE, SIG_IGN);
     
     // Install crash handlers for emergency cleanup
     signal(SIGSEGV, crash_handler);  // Segmentation fault
@@ -2887,8 +6989,9 @@ int main(int argc, char** argv) {
     bool skip_indexing = (db_enabled && !db_roots.empty());
     initial_setup(canonical_roots, skip_indexing);
     
-    // Reconcile DB with filesystem if database is enabled
-    if (db_enabled) {
+    // Reconcile entries loaded from the database with the filesystem
+    // (a fresh index is already current)
+    if (db_enabled && skip_indexing && !background_load) {
         if (foreground) {
             cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET 
                  << " Reconciling database with filesystem...\n";
@@ -2904,7 +7007,9 @@ int main(int argc, char** argv) {
     
     // Build path index for fast path-filtered queries
     // Must be called after all entries are loaded/indexed
-    build_path_index();
+    if (!path_index_valid && !background_load) {
+        build_path_index();
+    }
 
     // Initialize thread pool for parallel content search
     init_thread_pool();
@@ -2914,7 +7019,8 @@ int main(int argc, char** argv) {
              << " Creating Unix socket at: " << sock_path << "\n";
     }
 
-    int srv = socket(AF_UNIX, SOCK_STREAM, 0);
+    // Non-blocking so the event loop can drain the accept backlog
+    int srv = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (srv < 0) {
         cerr << COLOR_RED << "[ERROR]" << COLOR_RESET 
              << " Failed to create socket: " << strerror(errno) << "\n";
@@ -2963,89 +7069,51 @@ int main(int argc, char** argv) {
              << " Daemon ready. Listening on: " << sock_path << "\n";
     }
 
-    thread events_th(process_events);
-    thread accept_th([&]{
-        while (running) {
-            int c = accept(srv, nullptr, nullptr);
-            if (c > 0) {
-                // Atomically check and increment connection counter
-                // Use fetch_add to increment, then check if we exceeded the limit
-                int previous_count = active_connections.fetch_add(1);
-                
-                if (previous_count >= MAX_CONCURRENT_CLIENTS) {
-                    // Connection limit was already reached - reject and rollback
-                    active_connections.fetch_sub(1);  // Rollback the increment
-                    
-                    if (foreground) {
-                        cerr << COLOR_YELLOW << "[WARN]" << COLOR_RESET 
-                             << " Connection limit reached (" << MAX_CONCURRENT_CLIENTS 
-                             << "), rejecting connection\n";
-                    }
-                    const char* err = "Server busy: too many concurrent connections\n";
-                    safe_write_all(c, err, strlen(err));
-                    close(c);
-                } else {
-                    // Accepted - spawn handler thread
-                    // Connection counter already incremented above
-                    thread([c]() {
-                        handle_client(c);
-                        // Decrement connection counter when handler completes
-                        active_connections.fetch_sub(1);
-                    }).detach();
-                }
-            } else if (c < 0) {
-                // Save errno immediately after accept() fails
-                int saved_errno = errno;
-                
-                // If interrupted by signal, retry unless we're shutting down
-                if (saved_errno == EINTR) {
-                    if (!running) {
-                        break;
-                    }
-                    continue;
-                }
-                
-                // If socket was closed (EBADF) or shutdown (EINVAL), exit gracefully
-                if (saved_errno == EBADF || saved_errno == EINVAL) {
-                    break;  // Socket closed by signal handler, exit thread
-                }
-                
-                // For other transient errors, log and back off briefly to avoid busy-looping
-                if (foreground) {
-                    cerr << COLOR_YELLOW << "[WARN]" << COLOR_RESET
-                         << " accept() failed: " << strerror(saved_errno) << "\n";
-                }
-                this_thread::sleep_for(100ms);
-                
-                // Check if we're shutting down
-                if (!running) {
-                    break;
-                }
-            }
-        }
-    });
+    if (!init_event_loop(srv)) {
+        cerr << COLOR_RED << "[ERROR]" << COLOR_RESET 
+             << " Failed to set up event loop: " << strerror(errno) << "\n";
+        cleanup_on_socket_error(srv, true, sock_path);
+        return 1;
+    }
 
-    while (running) sleep(1);
+    if (!background_load) {
+        start_journal_writer();
+        start_db_writer();
+    }
+    run_event_loop(srv);
     running = 0;
-    events_th.join();
-    accept_th.join();
+    if (db_loader.joinable()) db_loader.join();
+    stop_db_writer();
     
-    // Cleanup socket - only close if not already closed by signal handler
+    // Cleanup socket - only close if not already closed by crash handler
     int fd = srv_fd.exchange(-1);
-    if (fd >= 0) {  // Only close if not already closed by signal handler
+    if (fd >= 0) {
         close(fd);
     }
-    // Always unlink socket file (whether closed by signal handler or not)
+    // Always unlink socket file
     unlink(sock_path.c_str());
     close(in_fd);
+    close(epoll_fd);
+    close(cleanup_tfd);
+    if (flush_tfd >= 0) close(flush_tfd);
     
-    // Graceful shutdown with database flush
-    if (db_enabled && db != nullptr) {
+    if (loader_efd >= 0) close(loader_efd);
+    
+    // Graceful shutdown with database flush. A partially loaded index must not
+    // be flushed or snapshotted; the database and journal are still intact.
+    if (db_enabled && db != nullptr && !index_complete) {
+        stop_journal_writer();
+        sqlite3_close(db);
+    } else if (db_enabled && db != nullptr) {
         if (foreground) {
             cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Flushing " << pending_changes 
                  << " changes to database...\n";
         }
         flush_changes_to_db();
+        if (static_cast<int64_t>(db_generation.load()) != snapshot_generation) {
+            write_index_snapshot();
+        }
+        stop_journal_writer();
         sqlite3_close(db);
         if (foreground) {
             cerr << COLOR_CYAN << "[INFO]" << COLOR_RESET << " Database closed.\n";
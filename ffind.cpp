@@ -20,6 +20,7 @@
 
 // Standard C++ headers
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <string>
 #include <memory>
@@ -125,7 +126,12 @@ int main(int argc, char** argv) {
              << "  ffind -size +1G -mtime -7\n"
              << "  ffind -c \"todo\" -r -i\n"
              << "  ffind -g \"TODO*\" -i\n"
-             << "  ffind \"*.cpp\" --color=always\n";
+             << "  ffind \"*.cpp\" --color=always\n"
+             << "  ffind -c \"todo\" --unordered\n"
+             << "  ffind -e \"strcpy\" -e \"sprintf\"\n"
+             << "  ffind -f patterns.txt -r\n"
+             << "  ffind -c \"todo\" -l --max-results 10\n"
+             << "  ffind -c \"todo\" --deadline 500 --max-bytes 65536\n";
         return 1;
     }
 
@@ -133,8 +139,11 @@ int main(int argc, char** argv) {
     string path_pat = "";
     string content_pat = "";
     string content_glob = "";
+    vector<string> patterns;  // -e/-f pattern list
+    bool multi = false;
     bool case_ins = false;
     bool is_regex = false;
+    bool unordered = false;
     uint8_t type_filter = 0;
     uint8_t size_op = 0;
     int64_t size_val = 0;
@@ -143,6 +152,12 @@ int main(int argc, char** argv) {
     ColorMode color_mode = ColorMode::AUTO;
     uint8_t before_ctx = 0;
     uint8_t after_ctx = 0;
+    bool files_only = false;    // -l: only the names of matching files
+    uint32_t max_results = 0;   // 0 = unlimited
+    uint32_t max_count = 0;     // Matches per file, 0 = unlimited
+    uint32_t deadline_ms = 0;   // Query budgets, 0 = unlimited
+    uint32_t max_bytes = 0;
+    uint32_t max_files = 0;
 
     bool has_dash = false;
     for (int i = 1; i < argc; ++i) if (argv[i][0] == '-') has_dash = true;
@@ -156,6 +171,18 @@ int main(int argc, char** argv) {
             if (arg == "-c") {
                 if (++i >= argc) { cerr << "Missing -c pattern\n"; return 1; }
                 content_pat = argv[i];
+            } else if (arg == "-e") {
+                if (++i >= argc) { cerr << "Missing -e pattern\n"; return 1; }
+                patterns.push_back(argv[i]);
+                multi = true;
+            } else if (arg == "-f") {
+                if (++i >= argc) { cerr << "Missing -f file\n"; return 1; }
+                ifstream in(argv[i]);
+                if (!in) { cerr << "Cannot read pattern file: " << argv[i] << "\n"; return 1; }
+                // One pattern per line, like grep -f
+                string pat;
+                while (getline(in, pat)) patterns.push_back(pat);
+                multi = true;
             } else if (arg == "-g") {
                 if (++i >= argc) { cerr << "Missing -g pattern\n"; return 1; }
                 content_glob = argv[i];
@@ -254,10 +281,34 @@ int main(int argc, char** argv) {
                 } catch (const out_of_range&) {
                     cerr << "-C value out of range\n"; return 1;
                 }
+            } else if (arg == "--max-results" || arg == "--max-count" || arg == "--deadline" ||
+                       arg == "--max-bytes" || arg == "--max-files") {
+                if (++i >= argc) { cerr << "Missing " << arg << " arg\n"; return 1; }
+                try {
+                    unsigned long val = stoul(argv[i]);
+                    if (val < 1 || val > UINT32_MAX || argv[i][0] == '-') {
+                        cerr << arg << " must be a positive integer\n"; return 1;
+                    }
+                    uint32_t& target = arg == "--max-results" ? max_results
+                                     : arg == "--max-count"   ? max_count
+                                     : arg == "--deadline"    ? deadline_ms
+                                     : arg == "--max-bytes"   ? max_bytes
+                                                              : max_files;
+                    target = static_cast<uint32_t>(val);
+                } catch (const invalid_argument&) {
+                    cerr << arg << " requires a valid integer\n"; return 1;
+                } catch (const out_of_range&) {
+                    cerr << arg << " value out of range\n"; return 1;
+                }
+            } else if (arg == "-l") {
+                files_only = true;
             } else if (arg == "-i") {
                 case_ins = true;
             } else if (arg == "-r") {
                 is_regex = true;
+            } else if (arg == "--unordered") {
+                // Content results in completion order instead of file order
+                unordered = true;
             } else if (arg.starts_with("--color=")) {
                 string mode = arg.substr(8);
                 if (mode == "never") color_mode = ColorMode::NEVER;
@@ -288,13 +339,34 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    if (is_regex && content_pat.empty()) {
-        cerr << "-r needs -c\n";
+    if (multi && (!content_pat.empty() || !content_glob.empty())) {
+        cerr << "Cannot use -e/-f with -c or -g\n";
+        return 1;
+    }
+
+    if (multi && patterns.empty()) {
+        cerr << "Pattern file is empty\n";
+        return 1;
+    }
+
+    if (is_regex && content_pat.empty() && !multi) {
+        cerr << "-r needs -c, -e or -f\n";
+        return 1;
+    }
+
+    if ((before_ctx > 0 || after_ctx > 0) && content_pat.empty() && content_glob.empty() && !multi) {
+        cerr << "Context lines (-A/-B/-C) need -c or -g (or -e/-f)\n";
+        return 1;
+    }
+
+    bool content_search = !content_pat.empty() || !content_glob.empty() || multi;
+    if ((files_only || max_count) && !content_search) {
+        cerr << "-l and --max-count need -c, -g, -e or -f\n";
         return 1;
     }
 
-    if ((before_ctx > 0 || after_ctx > 0) && content_pat.empty() && content_glob.empty()) {
-        cerr << "Context lines (-A/-B/-C) need -c or -g\n";
+    if (files_only && (before_ctx > 0 || after_ctx > 0)) {
+        cerr << "Cannot use -l with context lines (-A/-B/-C)\n";
         return 1;
     }
 
@@ -376,6 +448,13 @@ int main(int argc, char** argv) {
     if (case_ins) flags |= 1;
     if (is_regex) flags |= 2;
     if (!content_glob.empty()) flags |= 4; // bit 2 (value 4) for content_glob
+    if (unordered) flags |= 8;             // bit 3 (value 8) for unordered streaming
+    if (multi) flags |= 16;                // bit 4 (value 16): pattern list follows
+    bool limits = max_results || max_count;
+    if (limits) flags |= 32;               // bit 5 (value 32): result limits follow
+    if (files_only) flags |= 64;           // bit 6 (value 64): names of matching files only
+    bool budgets = deadline_ms || max_bytes || max_files;
+    if (budgets) flags |= 128;             // bit 7 (value 128): query budgets follow
     if (!safe_write_all(c, &flags, 1)) {
         cerr << "Failed to send flags\n";
         close(c);
@@ -424,10 +503,45 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    // Send the pattern list: count, then length + data per pattern
+    if (multi) {
+        uint32_t net_count = htonl(patterns.size());
+        bool sent = safe_write_all(c, &net_count, 4);
+        for (const string& pat : patterns) {
+            uint32_t net_len = htonl(pat.size());
+            sent = sent && safe_write_all(c, &net_len, 4) && safe_write_all(c, pat.data(), pat.size());
+        }
+        if (!sent) {
+            cerr << "Failed to send pattern list\n";
+            close(c);
+            return 1;
+        }
+    }
+
+    // Send result limits: total, then per file
+    if (limits) {
+        uint32_t net_limits[2] = {htonl(max_results), htonl(max_count)};
+        if (!safe_write_all(c, net_limits, sizeof(net_limits))) {
+            cerr << "Failed to send result limits\n";
+            close(c);
+            return 1;
+        }
+    }
+
+    // Send query budgets: deadline, result bytes, files searched
+    if (budgets) {
+        uint32_t net_budgets[3] = {htonl(deadline_ms), htonl(max_bytes), htonl(max_files)};
+        if (!safe_write_all(c, net_budgets, sizeof(net_budgets))) {
+            cerr << "Failed to send query budgets\n";
+            close(c);
+            return 1;
+        }
+    }
+
     // Read and colorize output incrementally
     // STREAMING OUTPUT: Process results as they arrive from daemon
     // This provides better responsiveness than buffering all results
-    bool has_content = !content_pat.empty() || !content_glob.empty();
+    bool has_content = content_search && !files_only;  // -l prints plain paths
     
     // Prepare regex for content matching if needed (for colorization)
     unique_ptr<RE2> re_matcher;
@@ -440,6 +554,8 @@ int main(int argc, char** argv) {
             return 1;
         }
     }
+    // Pattern list regexes (compiled lazily, only for highlighting)
+    vector<unique_ptr<RE2>> multi_res(multi && is_regex ? patterns.size() : 0);
     
     // Process output line by line as it arrives (streaming)
     string line_buffer;
@@ -451,7 +567,14 @@ int main(int argc, char** argv) {
     // Colors: path=bold, lineno=cyan, matched_content=bold_red
     auto process_line = [&](const string& line) {
         if (line.empty()) return;
-        
+
+        // Status line from the daemon (results always start with '/')
+        if (line[0] == '!') {
+            size_t sp = line.find(' ');
+            cerr << "ffind: " << (sp == string::npos ? line.substr(1) : line.substr(sp + 1)) << "\n";
+            return;
+        }
+
         // Check for separator line
         if (line == "--") {
             cout << "--\n";
@@ -502,16 +625,40 @@ int main(int argc, char** argv) {
             cout << BOLD << path << RESET << ":" 
                  << CYAN << lineno << RESET << (is_context_line ? "-" : ":");
             
+            // Pattern list matches carry "ids:" before the line; the first
+            // matching pattern is the one highlighted
+            const string* hl_pat = &content_pat;
+            RE2* hl_re = re_matcher.get();
+            if (multi && !is_context_line) {
+                size_t ids_end = content.find(':');
+                if (ids_end != string::npos) {
+                    cout << CYAN << content.substr(0, ids_end) << RESET << ":";
+                    size_t id = strtoul(content.c_str(), nullptr, 10);
+                    content.erase(0, ids_end + 1);
+                    if (id >= 1 && id <= patterns.size()) {
+                        hl_pat = &patterns[id - 1];
+                        if (is_regex) {
+                            if (!multi_res[id - 1]) {
+                                RE2::Options opts;
+                                opts.set_case_sensitive(!case_ins);
+                                multi_res[id - 1] = make_unique<RE2>(*hl_pat, opts);
+                            }
+                            hl_re = multi_res[id - 1].get();
+                        }
+                    }
+                }
+            }
+            
             // Highlight matching content only for match lines (not context lines)
-            if (use_colors && !is_context_line) {
+            if (use_colors && !is_context_line && !hl_pat->empty()) {
                 bool found_match = false;
                 size_t match_start = 0;
                 size_t match_len = 0;
                 
-                if (is_regex && re_matcher) {
+                if (is_regex && hl_re) {
                     re2::StringPiece input(content);
                     re2::StringPiece match;
-                    if (re_matcher->Match(input, 0, input.size(), re2::RE2::UNANCHORED, &match, 1)) {
+                    if (hl_re->Match(input, 0, input.size(), re2::RE2::UNANCHORED, &match, 1)) {
                         match_start = match.data() - content.data();
                         match_len = match.size();
                         found_match = true;
@@ -523,21 +670,21 @@ int main(int argc, char** argv) {
                 } else if (case_ins) {
                     // Case-insensitive substring search
                     string lower_content = content;
-                    string lower_pattern = content_pat;
+                    string lower_pattern = *hl_pat;
                     transform(lower_content.begin(), lower_content.end(), lower_content.begin(), ::tolower);
                     transform(lower_pattern.begin(), lower_pattern.end(), lower_pattern.begin(), ::tolower);
                     size_t pos = lower_content.find(lower_pattern);
                     if (pos != string::npos) {
                         match_start = pos;
-                        match_len = content_pat.size();
+                        match_len = hl_pat->size();
                         found_match = true;
                     }
                 } else {
                     // Case-sensitive substring search
-                    size_t pos = content.find(content_pat);
+                    size_t pos = content.find(*hl_pat);
                     if (pos != string::npos) {
                         match_start = pos;
-                        match_len = content_pat.size();
+                        match_len = hl_pat->size();
                         found_match = true;
                     }
                 }
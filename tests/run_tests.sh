@@ -554,6 +554,145 @@ else
 fi
 TOTAL_TESTS=$((TOTAL_TESTS + 1))
 
+# Test 11b: Many small files are searched in batches; every match must arrive
+echo ""
+echo "--- Batched Content Search Tests ---"
+mkdir -p "$TEMP_DIR/many"
+for i in $(seq 1 500); do
+    printf 'header %d\nbatchmarker %d\n' "$i" "$i" > "$TEMP_DIR/many/small$i.batch"
+done
+sleep 1
+run_test_exact_count "Content search across 500 small files" 500 "$FFIND_CLIENT" -name "*.batch" -c "batchmarker"
+run_test_exact_count "Context search across 500 small files" 1000 "$FFIND_CLIENT" -name "*.batch" -c "batchmarker" -B 1
+run_test_exact_count "Unordered content search across 500 small files" 500 "$FFIND_CLIENT" -name "*.batch" -c "batchmarker" --unordered
+
+# Test 11c: Literal search over the whole buffer must keep per-line semantics
+echo ""
+echo "--- Whole-Buffer Literal Search Tests ---"
+{
+    echo "wbneedle on the first line"
+    for i in $(seq 2 99); do echo "filler line $i"; done
+    echo "two hits wbneedle and wbneedle"
+    printf 'last line wbneedle without newline'
+} > "$TEMP_DIR/wholebuf.txt"
+sleep 1
+run_test_exact_count "Whole-buffer literal: one result per matching line" 3 "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle"
+run_test "Whole-buffer literal: line number after many lines" "wholebuf.txt:100:two hits" "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle"
+run_test "Whole-buffer literal: last line without newline" "wholebuf.txt:101:last line" "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle"
+run_test_exact_count "Whole-buffer literal: case-insensitive" 3 "$FFIND_CLIENT" -name "wholebuf.txt" -c "WBNeedle" -i
+run_test_exact_count "Case-insensitive literal does not fold punctuation" 0 "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle{" -i
+run_test_exact_count "Regex prefilter: regex checked on literal hits" 2 "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle (on|and)" -r
+run_test_exact_count "Regex prefilter: case-sensitive regex on folded hits" 0 "$FFIND_CLIENT" -name "wholebuf.txt" -c "WBNEEDLE" -r
+run_test_exact_count "Regex prefilter: alternation of literals" 12 "$FFIND_CLIENT" -name "wholebuf.txt" -c "filler line 5|last line" -r
+run_test_exact_count "Content glob: whole-buffer match of full lines" 11 "$FFIND_CLIENT" -name "wholebuf.txt" -g "filler line 5*"
+run_test_exact_count "Content glob: literal prefilter, case-insensitive" 3 "$FFIND_CLIENT" -name "wholebuf.txt" -g "*WBNEEDLE*" -i
+run_test_exact_count "Content glob: negated bracket" 3 "$FFIND_CLIENT" -name "wholebuf.txt" -g "[!f]*"
+run_test_exact_count "Content glob: fnmatch fallback (equivalence class)" 1 "$FFIND_CLIENT" -name "wholebuf.txt" -g "[[=f=]]iller line 7"
+run_test "Streaming context: before-context from skipped region" "wholebuf.txt:48-filler line 48" "$FFIND_CLIENT" -name "wholebuf.txt" -c "filler line 50" -B 2 -A 1
+run_test_exact_count "Streaming context: B + match + A lines" 4 "$FFIND_CLIENT" -name "wholebuf.txt" -c "filler line 50" -B 2 -A 1
+run_test_exact_count "Streaming context: after-context stops at EOF" 2 "$FFIND_CLIENT" -name "wholebuf.txt" -c "two hits" -A 3
+run_test_exact_count "Streaming context: consecutive matches form one group" 14 "$FFIND_CLIENT" -name "wholebuf.txt" -c "filler line 2" -A 1
+
+echo ""
+echo "--- Pattern List Tests ---"
+run_test_exact_count "Pattern list: one result per matching line" 4 "$FFIND_CLIENT" -name "wholebuf.txt" -e "wbneedle" -e "filler line 42"
+run_test "Pattern list: ids of all matching patterns" "wholebuf.txt:100:1,2:two hits" "$FFIND_CLIENT" -name "wholebuf.txt" -e "two hits" -e "wbneedle"
+run_test "Pattern list: regex patterns" "wholebuf.txt:7:2:filler line 7" "$FFIND_CLIENT" -name "wholebuf.txt" -e "nomatch\\w+" -e "^filler line 7$" -r
+printf 'WBNEEDLE\nfiller line 99\n' > "$TEMP_DIR/patterns.lst"
+run_test_exact_count "Pattern list: read from file, case-insensitive" 4 "$FFIND_CLIENT" -name "wholebuf.txt" -f "$TEMP_DIR/patterns.lst" -i
+rm -f "$TEMP_DIR/patterns.lst"
+
+echo ""
+echo "--- Result Limit Tests ---"
+run_test_exact_count "Result limits: --max-count per file" 2 "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle" --max-count 2
+run_test_exact_count "Result limits: -l lists a file once" 1 "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle" -l
+run_test_exact_count "Result limits: --max-results across files" 3 "$FFIND_CLIENT" -c "e" --max-results 3
+run_test_exact_count "Result limits: --max-results unordered" 3 "$FFIND_CLIENT" -c "e" --max-results 3 --unordered
+run_test_exact_count "Result limits: --max-results on paths" 2 "$FFIND_CLIENT" "*" --max-results 2
+
+echo ""
+echo "--- Query Budget Tests ---"
+run_test "Query budgets: --max-files reports truncation" "file budget of 1 reached" "$FFIND_CLIENT" -c "e" --max-files 1
+run_test_exact_count "Query budgets: --max-bytes sends whole lines only" 1 "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle" --max-bytes 1
+run_test_exact_count "Query budgets: --deadline leaves fast queries whole" 1 "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle" -l --deadline 60000
+
+echo ""
+echo "--- Client Disconnect Tests ---"
+# Enough output to fill the socket buffers many times over, so the daemon is
+# still searching when the client goes away. The daemon is restarted with
+# its log captured (outside the watched tree) to see the search cancelled.
+mkdir -p "$TEMP_DIR/hangup"
+for i in $(seq 1 400); do
+    seq 1 2000 | sed 's/^/hangup line /' > "$TEMP_DIR/hangup/f$i.txt"
+done
+kill "$DAEMON_PID" 2>/dev/null || true
+wait "$DAEMON_PID" 2>/dev/null || true
+DISCONNECT_LOG=$(mktemp -t ffind_disconnect_XXXXXX)
+"$FFIND_DAEMON" --foreground "$TEMP_DIR" 2> "$DISCONNECT_LOG" &
+DAEMON_PID=$!
+sleep 2
+"$FFIND_CLIENT" -path "hangup/*" -c "hangup line" | head -1 > /dev/null
+sleep 1
+TOTAL_TESTS=$((TOTAL_TESTS + 1))
+if kill -0 "$DAEMON_PID" 2>/dev/null; then
+    echo -e "${GREEN}✓${NC} PASS: Client disconnect: daemon survives a closed pipe"
+    PASSED_TESTS=$((PASSED_TESTS + 1))
+else
+    echo -e "${RED}✗${NC} FAIL: Client disconnect: daemon died on a closed pipe"
+    FAILED_TESTS=$((FAILED_TESTS + 1))
+fi
+TOTAL_TESTS=$((TOTAL_TESTS + 1))
+if grep -q "Client disconnected, content search cancelled" "$DISCONNECT_LOG"; then
+    echo -e "${GREEN}✓${NC} PASS: Client disconnect: content search cancelled"
+    PASSED_TESTS=$((PASSED_TESTS + 1))
+else
+    echo -e "${RED}✗${NC} FAIL: Client disconnect: content search not cancelled"
+    FAILED_TESTS=$((FAILED_TESTS + 1))
+fi
+rm -rf "$TEMP_DIR/hangup" "$DISCONNECT_LOG"
+sleep 1
+run_test "Client disconnect: next query answered" "wholebuf.txt" "$FFIND_CLIENT" -name "wholebuf.txt" -c "wbneedle" -l
+
+echo ""
+echo "--- Special File Tests ---"
+ln -s /dev/zero "$TEMP_DIR/zero_link"
+sleep 1
+run_test_exact_count "Special files: device behind a symlink skipped" 0 "$FFIND_CLIENT" -name "zero_link" -c "wbneedle"
+run_test "Special files: regular files still searched" "wholebuf.txt" "$FFIND_CLIENT" -c "wbneedle" -l
+TOTAL_TESTS=$((TOTAL_TESTS + 1))
+rss_kb=$(awk '/^VmRSS/ {print $2}' "/proc/$DAEMON_PID/status" 2>/dev/null || echo 0)
+if [ "${rss_kb:-0}" -gt 0 ] && [ "$rss_kb" -lt 262144 ]; then
+    echo -e "${GREEN}✓${NC} PASS: Special files: daemon memory stays bounded"
+    PASSED_TESTS=$((PASSED_TESTS + 1))
+else
+    echo -e "${RED}✗${NC} FAIL: Special files: daemon RSS ${rss_kb} kB after searching /dev/zero"
+    FAILED_TESTS=$((FAILED_TESTS + 1))
+fi
+rm -f "$TEMP_DIR/zero_link"
+
+echo ""
+echo "--- Content Cache Tests ---"
+printf 'cachekey one\nfiller\n' > "$TEMP_DIR/cached.txt"
+sleep 1
+run_test_exact_count "Content cache: first query" 1 "$FFIND_CLIENT" -name "cached.txt" -c "cachekey"
+run_test_exact_count "Content cache: repeated query" 1 "$FFIND_CLIENT" -name "cached.txt" -c "cachekey"
+printf 'cachekey two\n' >> "$TEMP_DIR/cached.txt"
+run_test_exact_count "Content cache: modified file rescanned" 2 "$FFIND_CLIENT" -name "cached.txt" -c "cachekey"
+rm -f "$TEMP_DIR/cached.txt"
+
+echo ""
+echo "--- Query Cache Tests ---"
+touch "$TEMP_DIR/qcache1.dat" "$TEMP_DIR/qcache2.dat"
+sleep 1
+run_test_exact_count "Query cache: first query" 2 "$FFIND_CLIENT" "qcache*.dat"
+run_test_exact_count "Query cache: repeated query" 2 "$FFIND_CLIENT" "qcache*.dat"
+touch "$TEMP_DIR/qcache3.dat"
+rm -f "$TEMP_DIR/qcache1.dat"
+sleep 1
+run_test_exact_count "Query cache: changes applied to cached result" 2 "$FFIND_CLIENT" "qcache*.dat"
+run_test "Query cache: new file in cached result" "qcache3.dat" "$FFIND_CLIENT" "qcache*.dat"
+rm -f "$TEMP_DIR"/qcache*.dat
+
 # Test 12: Real-time indexing
 echo ""
 echo "--- Real-time Indexing Tests ---"
@@ -214,5 +214,208 @@ else
     test_result "Deleted file removed from database (expected 4, got $FINAL_COUNT)" "fail"
 fi
 
+echo ""
+echo "Test 8: Live changes persisted incrementally"
+$FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" 2>&1 > /dev/null &
+DAEMON_PID=$!
+sleep 2
+
+# Create, delete and rename while the daemon is watching
+echo "file5 content" > "$TEST_ROOT/file5.txt"
+rm -f "$TEST_ROOT/file2.txt"
+mv "$TEST_ROOT/subdir" "$TEST_ROOT/subdir2"
+sleep 2
+
+kill "$DAEMON_PID" 2>/dev/null || true
+wait "$DAEMON_PID" 2>/dev/null || true
+
+LIVE_COUNT=$(sqlite3 "$DB_PATH" "SELECT COUNT(*) FROM entries;")
+RENAMED=$(sqlite3 "$DB_PATH" "SELECT COUNT(*) FROM entries WHERE path = '$TEST_ROOT/subdir2/file3.txt';")
+STALE=$(sqlite3 "$DB_PATH" "SELECT COUNT(*) FROM entries WHERE path LIKE '%/file2.txt' OR path LIKE '%/subdir/%';")
+if [ "$LIVE_COUNT" -eq 4 ] && [ "$RENAMED" -eq 1 ] && [ "$STALE" -eq 0 ]; then
+    test_result "Live create/delete/rename persisted" "pass"
+else
+    test_result "Live create/delete/rename persisted (count $LIVE_COUNT, renamed $RENAMED, stale $STALE)" "fail"
+fi
+
+echo ""
+echo "Test 9: Background flush while daemon is running"
+$FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" 2>&1 > /dev/null &
+DAEMON_PID=$!
+sleep 2
+
+# Exceed the flush threshold (100 changes) without stopping the daemon
+mkdir -p "$TEST_ROOT/bulk"
+for i in $(seq 1 120); do
+    echo "bulk $i" > "$TEST_ROOT/bulk/file$i.txt"
+done
+sleep 2
+
+BULK_COUNT=$(sqlite3 "$DB_PATH" "SELECT COUNT(*) FROM entries WHERE path LIKE '$TEST_ROOT/bulk/%';")
+kill "$DAEMON_PID" 2>/dev/null || true
+wait "$DAEMON_PID" 2>/dev/null || true
+
+if [ "$BULK_COUNT" -gt 0 ]; then
+    test_result "Changes flushed by writer thread while running ($BULK_COUNT rows)" "pass"
+else
+    test_result "Changes flushed by writer thread while running (only $BULK_COUNT rows)" "fail"
+fi
+
+echo ""
+echo "Test 10: Binary index snapshot used on restart"
+SNAP_LOG="$TEST_DIR/snapshot.log"
+if [ -f "$DB_PATH.snap" ]; then
+    $FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" > /dev/null 2> "$SNAP_LOG" &
+    DAEMON_PID=$!
+    sleep 2
+    SNAP_RESULTS=$("$FFIND_CLIENT" "*.txt" 2>/dev/null | wc -l)
+    kill "$DAEMON_PID" 2>/dev/null || true
+    wait "$DAEMON_PID" 2>/dev/null || true
+    if grep -q "from index snapshot" "$SNAP_LOG" && [ "$SNAP_RESULTS" -gt 0 ]; then
+        test_result "Index loaded from snapshot and queryable" "pass"
+    else
+        test_result "Index loaded from snapshot and queryable" "fail"
+    fi
+    
+    # A corrupted snapshot must be rejected in favour of the database
+    printf '\xff\xff\xff\xff' | dd of="$DB_PATH.snap" bs=1 seek=100 conv=notrunc 2>/dev/null
+    $FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" > /dev/null 2> "$SNAP_LOG" &
+    DAEMON_PID=$!
+    sleep 2
+    kill "$DAEMON_PID" 2>/dev/null || true
+    wait "$DAEMON_PID" 2>/dev/null || true
+    if grep -q "Ignoring index snapshot" "$SNAP_LOG" && grep -q "entries from database" "$SNAP_LOG"; then
+        test_result "Corrupt snapshot falls back to database" "pass"
+    else
+        test_result "Corrupt snapshot falls back to database" "fail"
+    fi
+    
+    # Paths are only checked by the loader thread, after entries were mapped
+    SNAP_SIZE=$(stat -c %s "$DB_PATH.snap")
+    printf 'Z' | dd of="$DB_PATH.snap" bs=1 seek=$((SNAP_SIZE - 16)) conv=notrunc 2>/dev/null
+    $FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" > /dev/null 2> "$SNAP_LOG" &
+    DAEMON_PID=$!
+    sleep 2
+    SNAP_RESULTS=$("$FFIND_CLIENT" "*.txt" 2>/dev/null | wc -l)
+    kill "$DAEMON_PID" 2>/dev/null || true
+    wait "$DAEMON_PID" 2>/dev/null || true
+    if grep -q "checksum mismatch in paths" "$SNAP_LOG" && grep -q "entries from database" "$SNAP_LOG" &&
+       [ "$SNAP_RESULTS" -gt 0 ]; then
+        test_result "Corrupt snapshot paths fall back to database" "pass"
+    else
+        test_result "Corrupt snapshot paths fall back to database" "fail"
+    fi
+else
+    test_result "Snapshot file written on shutdown" "fail"
+fi
+
+echo ""
+echo "Test 11: Reconciliation descends only into changed directories"
+RECON_LOG="$TEST_DIR/reconcile.log"
+mkdir -p "$TEST_ROOT/deep/a/b" "$TEST_ROOT/other/c"
+echo "x" > "$TEST_ROOT/other/c/keep.txt"
+$FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" > /dev/null 2>&1 &
+DAEMON_PID=$!
+sleep 2
+kill "$DAEMON_PID" 2>/dev/null || true
+wait "$DAEMON_PID" 2>/dev/null || true
+
+# Offline changes deep in one subtree, plus removal of a whole directory
+sleep 1
+echo "new" > "$TEST_ROOT/deep/a/b/offline.txt"
+rm -rf "$TEST_ROOT/bulk"
+$FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" > /dev/null 2> "$RECON_LOG" &
+DAEMON_PID=$!
+sleep 2
+kill "$DAEMON_PID" 2>/dev/null || true
+wait "$DAEMON_PID" 2>/dev/null || true
+
+OFFLINE=$(sqlite3 "$DB_PATH" "SELECT COUNT(*) FROM entries WHERE path = '$TEST_ROOT/deep/a/b/offline.txt';")
+BULK_LEFT=$(sqlite3 "$DB_PATH" "SELECT COUNT(*) FROM entries WHERE path LIKE '$TEST_ROOT/bulk%';")
+if [ "$OFFLINE" -eq 1 ] && [ "$BULK_LEFT" -eq 0 ] && grep -Eq "skipped [1-9][0-9]* unchanged" "$RECON_LOG"; then
+    test_result "Offline changes reconciled, unchanged directories skipped" "pass"
+else
+    test_result "Offline changes reconciled (offline $OFFLINE, bulk $BULK_LEFT)" "fail"
+    grep -a "Reconciliation" "$RECON_LOG" || true
+fi
+
+echo ""
+echo "Test 12: Journal recovers changes after a crash"
+$FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" > /dev/null 2>&1 &
+DAEMON_PID=$!
+sleep 2
+
+# Grow a file in place (reconciliation alone would not notice) and crash
+echo "much longer content than before" > "$TEST_ROOT/other/c/keep.txt"
+EXPECTED_SIZE=$(stat -c %s "$TEST_ROOT/other/c/keep.txt")
+sleep 1
+kill -9 "$DAEMON_PID" 2>/dev/null || true
+wait "$DAEMON_PID" 2>/dev/null || true
+
+JOURNAL_LOG="$TEST_DIR/journal.log"
+$FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" > /dev/null 2> "$JOURNAL_LOG" &
+DAEMON_PID=$!
+sleep 2
+kill "$DAEMON_PID" 2>/dev/null || true
+wait "$DAEMON_PID" 2>/dev/null || true
+
+STORED_SIZE=$(sqlite3 "$DB_PATH" "SELECT size FROM entries WHERE path = '$TEST_ROOT/other/c/keep.txt';")
+if grep -q "from journal" "$JOURNAL_LOG" && [ "$STORED_SIZE" = "$EXPECTED_SIZE" ]; then
+    test_result "Journaled change replayed after crash" "pass"
+else
+    test_result "Journaled change replayed after crash (size $STORED_SIZE, expected $EXPECTED_SIZE)" "fail"
+fi
+
+echo ""
+echo "Test 13: Legacy one-path-per-row database is converted"
+LEGACY_DB="$TEST_DIR/legacy.db"
+LEGACY_ROOT="$TEST_DIR/legacy_root"
+mkdir -p "$LEGACY_ROOT/sub"
+echo "a" > "$LEGACY_ROOT/sub/a.txt"
+LEGACY_MTIME=$(stat -c %Y "$LEGACY_ROOT/sub/a.txt")
+SUB_MTIME=$(stat -c %Y "$LEGACY_ROOT/sub")
+sqlite3 "$LEGACY_DB" <<SQL
+CREATE TABLE meta (key TEXT PRIMARY KEY, value TEXT);
+CREATE TABLE entries (id INTEGER PRIMARY KEY, path TEXT UNIQUE NOT NULL, size INTEGER NOT NULL,
+                      mtime INTEGER NOT NULL, is_dir INTEGER NOT NULL, root_index INTEGER NOT NULL);
+CREATE INDEX idx_path ON entries(path);
+INSERT INTO meta VALUES ('root_paths', '["$LEGACY_ROOT/"]');
+INSERT INTO entries (path, size, mtime, is_dir, root_index) VALUES
+    ('$LEGACY_ROOT/sub', 0, $SUB_MTIME, 1, 0),
+    ('$LEGACY_ROOT/sub/a.txt', 2, $LEGACY_MTIME, 0, 0);
+SQL
+$FFIND_DAEMON --foreground --db "$LEGACY_DB" "$LEGACY_ROOT" > /dev/null 2>&1 &
+DAEMON_PID=$!
+sleep 2
+kill "$DAEMON_PID" 2>/dev/null || true
+wait "$DAEMON_PID" 2>/dev/null || true
+
+LEGACY_TABLES=$(sqlite3 "$LEGACY_DB" "SELECT name FROM sqlite_master WHERE type='table' ORDER BY name;")
+LEGACY_ROWS=$(sqlite3 "$LEGACY_DB" "SELECT COUNT(*) FROM entries WHERE path = '$LEGACY_ROOT/sub/a.txt';")
+if echo "$LEGACY_TABLES" | grep -qx "dir_entries" && ! echo "$LEGACY_TABLES" | grep -qx "entries" && [ "$LEGACY_ROWS" -eq 1 ]; then
+    test_result "Legacy entries table converted to directory/basename rows" "pass"
+else
+    test_result "Legacy entries table converted to directory/basename rows" "fail"
+fi
+
+echo ""
+echo "Test 14: Database load runs in the background and completes"
+LOAD_LOG="$TEST_DIR/load.log"
+EXPECTED_ROWS=$(sqlite3 "$DB_PATH" "SELECT COUNT(*) FROM entries;")
+rm -f "$DB_PATH.snap"
+$FFIND_DAEMON --foreground --db "$DB_PATH" "$TEST_ROOT" > /dev/null 2> "$LOAD_LOG" &
+DAEMON_PID=$!
+sleep 2
+LOADED_ROWS=$("$FFIND_CLIENT" "*" 2>/dev/null | wc -l)
+kill "$DAEMON_PID" 2>/dev/null || true
+wait "$DAEMON_PID" 2>/dev/null || true
+
+if grep -q "connections" "$LOAD_LOG" && grep -q "Index load complete" "$LOAD_LOG" && \
+   [ "$LOADED_ROWS" -eq "$EXPECTED_ROWS" ]; then
+    test_result "Background load serves the full index ($LOADED_ROWS entries)" "pass"
+else
+    test_result "Background load serves the full index ($LOADED_ROWS of $EXPECTED_ROWS entries)" "fail"
+fi
+
 echo ""
 echo "All tests completed!"